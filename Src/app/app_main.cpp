@@ -1,45 +1,64 @@
 #include "bsp/dwt/dwt.h"
+#include "bsp/sleep/sleep.hpp"
 #include "device/can_comm/can_comm.hpp"
 #include "device/face/face.hpp"
 #include "device/finger/finger.hpp"
 #include "main.h"
+#include "tool/coro/coro.hpp"
+#include "tool/deadline.hpp"
+#include "tool/deamon/daemon.hpp"
+
+#include <utility>
 
 namespace app {
 using namespace device;
+using namespace std::chrono_literals;
 finger finger{device::finger::finger_params()};
 face face{device::face::face_params()};
 can_comm can_comm{device::can_comm::can_comm_params()};
 
+// status fields are one byte wide; counters stick at 255
+constexpr uint8_t saturate_u8(uint32_t value) {
+    return value > 0xFF ? 0xFF : static_cast<uint8_t>(value);
+}
+
 extern "C" [[noreturn]] void app_main() {
     static bool last_power_save_flag = false;
     static bool last_door_open_flag  = false;
+    static tool::timeout success_hold;
 
     can_comm_instance = &can_comm;
-    HAL_TIM_Base_Start_IT(&htim4);
     DWT_Init();
-    DWT_Delay(0.3);
+    tool::daemon_base::Begin();
+    bsp::dwt::delay(300ms);
     finger.Begin();
     face.Begin();
     can_comm.Begin();
     face.bind_finger(&finger);
     __enable_irq();
 
-    DWT_Delay(0.5);                        // wait for the system to be ready
-
-    finger.get_user_count();
-    DWT_Delay(0.1);                        // wait for response
+    bsp::dwt::delay(500ms);                // wait for the system to be ready
 
     HAL_GPIO_WritePin(
         GPIOB, GPIO_PIN_15, GPIO_PIN_SET); // when the system is ready, turn off status LED
 
-    // DWT_Delay(1);
+    // bsp::dwt::delay(1s);
     // finger.delete_all();
     // face.delete_all();
-    // DWT_Delay(1);
+    // bsp::dwt::delay(1s);
 
     finger.resume_LED();
+    // move both module links to their target baud rates; finger reads its user count afterwards
+    finger.negotiate_baud();
+    face.negotiate_baud();
+    bsp::sleep::Begin();
 
     while (true) {
+        // run daemon callbacks that must not touch UART/CAN from the TIM4 ISR
+        tool::daemon_base::RunDeferred();
+        // decode CAN frames queued by the RX ISR
+        bsp::can_base::ProcessRx();
+
         // handle finger&face
         if (finger.is_waiting_identify()) {
             finger.identify();
@@ -52,6 +71,10 @@ extern "C" [[noreturn]] void app_main() {
             if (face.is_waiting_identify()) {
                 face.identify();
             }
+        }
+        // enroll replies must be decoded even while the door is open
+        if (can_comm.get_door_open_flag() == false || face.is_enrolling()
+            || face.is_link_negotiating()) {
             if (face.is_waiting_decode()) {
                 face.decode();
             }
@@ -67,12 +90,14 @@ extern "C" [[noreturn]] void app_main() {
         last_power_save_flag = can_comm.get_power_save_flag();
         last_door_open_flag  = can_comm.get_door_open_flag();
 
-        // success handle
-        if (identify_success == true) {
+        // success handle, hold the success state for 3s without blocking the loop
+        if (identify_success == true && !success_hold.IsRunning()) {
             can_comm.send_identify_success();
             can_comm.send_request(request::success_tone);
             finger.set_notice(finger::LED_states::success);
-            DWT_Delay(3);
+            success_hold.Start(3s);
+        }
+        if (success_hold.Expired()) {
             identify_success = false;
         }
 
@@ -83,6 +108,23 @@ extern "C" [[noreturn]] void app_main() {
         if (can_comm.get_face_enroll_flag() == true) {
             face.enroll_interactive();
         }
+        finger.poll();
+
+        // refresh the status table; can_comm only sends the fields that changed
+        can_comm.set_status(status_field::finger_enroll_remaining, finger.get_enroll_remaining());
+        can_comm.set_status(status_field::face_enrolling, face.is_enrolling());
+        can_comm.set_status(status_field::finger_user_count,
+                            std::as_const(finger).get_user_count());
+        can_comm.set_status(status_field::finger_link_negotiating, finger.is_link_negotiating());
+        can_comm.set_status(status_field::face_link_negotiating, face.is_link_negotiating());
+        can_comm.set_status(status_field::finger_link_recoveries,
+                            saturate_u8(finger.get_link_stats().recoveries));
+        can_comm.set_status(status_field::face_link_recoveries,
+                            saturate_u8(face.get_link_stats().recoveries));
+        can_comm.set_status(status_field::can_bus_state,
+                            static_cast<uint8_t>(bsp::can_base::GetBusState()));
+        can_comm.poll();
+        tool::coro::executor::Poll();
 
         // finger LED control
         if (human_detected == true) {
@@ -94,6 +136,9 @@ extern "C" [[noreturn]] void app_main() {
         } else {
             finger.set_LED_off();
         }
+
+        // nothing pending, sleep until an interrupt reports an event
+        bsp::sleep::WaitForEvent();
     }
 }
 } // namespace app
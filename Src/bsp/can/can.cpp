@@ -1,30 +1,678 @@
 #include "can.hpp"
+#include "bsp/irq_trace/irq_trace.h"
+#include "bsp/sleep/sleep.hpp"
+#include "tool/critical_section.hpp"
+#include "tool/deamon/daemon.hpp"
+
+#include <bit>
+#include <cstring>
+#include <initializer_list>
 
 namespace bsp {
 
 // 初始化静态成员变量
-can_base* can_base::can_instances_[can_base::MAX_CAN_INSTANCES] = {nullptr};
-size_t can_base::can_instance_count_                            = 0;
+tool::registry<can_base, 2 * can_base::MAX_FILTER_NUMBERS> can_base::can_instances_;
+can_base::subscription can_base::subscriptions_[can_base::MAX_SUBSCRIPTIONS];
+uint8_t can_base::subscription_count_ = 0;
+uint32_t can_base::filter_banks_used_ = 0;
+bool can_base::started_               = false;
+can_tx_frame can_base::tx_queue_[can_base::TX_QUEUE_SIZE];
+uint8_t can_base::tx_count_ = 0;
+can_tx_frame can_base::tx_mailbox_frames_[can_base::TX_MAILBOXES];
+uint8_t can_base::tx_mailbox_busy_   = 0;
+int8_t can_base::tx_preempt_mailbox_ = -1;
+can_tx_stats can_base::tx_stats_     = {0, 0, 0, 0};
+can_rx_frame can_base::rx_ring_[can_base::RX_RING_SIZE];
+std::atomic<uint8_t> can_base::rx_head_ = 0;
+std::atomic<uint8_t> can_base::rx_tail_ = 0;
+can_rx_stats can_base::rx_stats_        = {};
+
+class can_base::bus_monitor final : public tool::daemon_base {
+public:
+    bus_monitor()
+        : daemon_base(MONITOR_PERIOD, mode::deferred, "can::bus") {}
+    void OnCallback() override { can_base::monitor_bus(); }
+};
+
+can_base::bus_monitor can_base::bus_monitor_;
+can_bus_state can_base::bus_state_                = can_bus_state::error_active;
+can_bus_stats can_base::bus_stats_                = {};
+dwt::clock::duration can_base::bus_off_backoff_   = BUS_OFF_BACKOFF_MIN;
+uint8_t can_base::init_polls_                     = 0;
+uint32_t can_base::bus_bits_                      = 0;
+dwt::clock::time_point can_base::bus_sampled_at_ = {};
+
+bool can_base::Subscribe(const can_filter& filter) {
+    can_filter normalized = filter;
+    normalized.mask &= 0x7FF;
+    normalized.id &= normalized.mask;
+    {
+        tool::critical_section cs;
+        for (uint8_t i = 0; i < subscription_count_; ++i) {
+            const can_filter& existing = subscriptions_[i].filter;
+            if (existing.id == normalized.id && existing.mask == normalized.mask) {
+                return subscriptions_[i].owner == this;
+            }
+        }
+        if (subscription_count_ == MAX_SUBSCRIPTIONS) {
+            return false;
+        }
+        subscriptions_[subscription_count_++] = {normalized, this, CAN_RX_FIFO0};
+    }
+    if (!started_ || CommitFilters()) {
+        return true;
+    }
+    // bank不足: 撤销这条订阅,已提交的过滤器未被修改
+    tool::critical_section cs;
+    for (uint8_t i = 0; i < subscription_count_; ++i) {
+        const can_filter& existing = subscriptions_[i].filter;
+        if (existing.id == normalized.id && existing.mask == normalized.mask) {
+            subscriptions_[i] = subscriptions_[--subscription_count_];
+            break;
+        }
+    }
+    return false;
+}
+
+void can_base::remove_subscriptions(const can_base* owner) {
+    tool::critical_section cs;
+    uint8_t kept = 0;
+    for (uint8_t i = 0; i < subscription_count_; ++i) {
+        if (subscriptions_[i].owner != owner) {
+            subscriptions_[kept++] = subscriptions_[i];
+        }
+    }
+    subscription_count_ = kept;
+}
+
+bool can_base::CommitFilters() {
+    tool::critical_section cs;
+
+    // 排序、FIFO分配和bank计数都在副本上进行,bank不足时订阅表保持不变
+    subscription staged[MAX_SUBSCRIPTIONS];
+    uint8_t count = subscription_count_;
+    for (uint8_t i = 0; i < count; ++i) {
+        staged[i] = subscriptions_[i];
+    }
+
+    // 按(id, mask)插入排序,使bank布局与订阅顺序无关
+    for (uint8_t i = 1; i < count; ++i) {
+        subscription current = staged[i];
+        uint8_t pos          = i;
+        while (pos > 0
+               && (staged[pos - 1].filter.id > current.filter.id
+                   || (staged[pos - 1].filter.id == current.filter.id
+                       && staged[pos - 1].filter.mask > current.filter.mask))) {
+            staged[pos] = staged[pos - 1];
+            --pos;
+        }
+        staged[pos] = current;
+    }
+
+    // 按load从大到小依次放入当前累计负载较小的FIFO
+    uint32_t fifo_load[2] = {0, 0};
+    uint32_t assigned     = 0;
+    for (uint8_t n = 0; n < count; ++n) {
+        uint8_t heaviest = 0xFF;
+        for (uint8_t i = 0; i < count; ++i) {
+            if ((assigned & (1U << i)) == 0U
+                && (heaviest == 0xFF
+                    || staged[i].filter.load > staged[heaviest].filter.load)) {
+                heaviest = i;
+            }
+        }
+        assigned |= 1U << heaviest;
+        uint8_t fifo = fifo_load[CAN_RX_FIFO0] <= fifo_load[CAN_RX_FIFO1] ? CAN_RX_FIFO0
+                                                                          : CAN_RX_FIFO1;
+        staged[heaviest].fifo = fifo;
+        fifo_load[fifo] += staged[heaviest].filter.load;
+    }
+
+    // 每个FIFO: 精确ID每bank 4个,掩码范围每bank 2个
+    uint32_t exact_count[2]  = {0, 0};
+    uint32_t masked_count[2] = {0, 0};
+    for (uint8_t i = 0; i < count; ++i) {
+        ++(staged[i].filter.IsExact() ? exact_count : masked_count)[staged[i].fifo];
+    }
+    uint32_t banks = 0;
+    for (uint32_t fifo = 0; fifo < 2; ++fifo) {
+        banks += (exact_count[fifo] + 3) / 4 + (masked_count[fifo] + 1) / 2;
+    }
+    if (banks > MAX_FILTER_BANKS) {
+        return false;
+    }
+    for (uint8_t i = 0; i < count; ++i) {
+        subscriptions_[i] = staged[i];
+    }
+
+    // 16位过滤器格式: STID[10:0] RTR IDE EXID[17:15],RTR/IDE为0即标准数据帧
+    auto value = [](uint16_t id) { return static_cast<uint32_t>(id) << 5; };
+    auto mask  = [](uint16_t bits) { return (static_cast<uint32_t>(bits) << 5) | 0x18U; };
+
+    can_instances_.Clear();
+    uint32_t bank = 0;
+    CAN_FilterTypeDef filter;
+    filter.FilterScale          = CAN_FILTERSCALE_16BIT;
+    filter.FilterActivation     = ENABLE;
+    filter.SlaveStartFilterBank = MAX_FILTER_BANKS;
+    for (uint32_t fifo = 0; fifo < 2; ++fifo) {
+        // 过滤器匹配序号在每个FIFO内按bank号递增编号,16位列表bank占4个,16位掩码bank占2个
+        uint32_t fmi                = 0;
+        filter.FilterFIFOAssignment = fifo;
+        for (bool exact : {true, false}) {
+            uint32_t per_bank = exact ? 4 : 2;
+            const subscription* slots[4];
+            uint32_t used = 0;
+            for (uint8_t i = 0; i <= subscription_count_; ++i) {
+                bool last = i == subscription_count_;
+                if (!last
+                    && (subscriptions_[i].fifo != fifo
+                        || subscriptions_[i].filter.IsExact() != exact)) {
+                    continue;
+                }
+                if (!last) {
+                    slots[used++] = &subscriptions_[i];
+                }
+                if (used == 0 || (used < per_bank && !last)) {
+                    continue;
+                }
+                // 不足的位置重复第一项,重复项匹配到的报文归属相同
+                for (uint32_t k = used; k < per_bank; ++k) {
+                    slots[k] = slots[0];
+                }
+                filter.FilterBank = bank++;
+                if (exact) {
+                    filter.FilterMode       = CAN_FILTERMODE_IDLIST;
+                    filter.FilterIdLow      = value(slots[0]->filter.id);
+                    filter.FilterMaskIdLow  = value(slots[1]->filter.id);
+                    filter.FilterIdHigh     = value(slots[2]->filter.id);
+                    filter.FilterMaskIdHigh = value(slots[3]->filter.id);
+                } else {
+                    filter.FilterMode       = CAN_FILTERMODE_IDMASK;
+                    filter.FilterIdLow      = value(slots[0]->filter.id);
+                    filter.FilterMaskIdLow  = mask(slots[0]->filter.mask);
+                    filter.FilterIdHigh     = value(slots[1]->filter.id);
+                    filter.FilterMaskIdHigh = mask(slots[1]->filter.mask);
+                }
+                if (HAL_CAN_ConfigFilter(&hcan, &filter) != HAL_OK) {
+                    // 过滤器配置错误处理
+                }
+                for (uint32_t k = 0; k < per_bank; ++k) {
+                    can_instances_.Register(instance_key(fifo, fmi + k), slots[k]->owner);
+                }
+                fmi += per_bank;
+                used = 0;
+            }
+        }
+    }
+
+    // 关闭上次提交使用而本次不再需要的bank
+    filter.FilterActivation = DISABLE;
+    for (uint32_t unused = bank; unused < filter_banks_used_; ++unused) {
+        filter.FilterBank = unused;
+        HAL_CAN_ConfigFilter(&hcan, &filter);
+    }
+    filter_banks_used_ = bank;
+    return true;
+}
+
+bool can_base::Transmit(const uint8_t* tx_data, uint8_t length, uint32_t id) {
+    can_tx_frame frame = {};
+    frame.id           = id != 0 ? id : tx_id_;
+    frame.length       = length < sizeof(frame.data) ? length : sizeof(frame.data);
+    std::memcpy(frame.data, tx_data, frame.length);
+
+    tool::critical_section cs;
+    // 有邮箱正被中止时为被中止的帧保留一个位置
+    auto limit = static_cast<uint8_t>(TX_QUEUE_SIZE - (tx_preempt_mailbox_ >= 0 ? 1 : 0));
+    if (!make_room(frame.id, limit)) {
+        ++tx_stats_.dropped;
+        return false;
+    }
+    enqueue(frame, false);
+    fill_mailboxes();
+    preempt_mailbox();
+    return true;
+}
+
+can_tx_stats can_base::GetTxStats() {
+    tool::critical_section cs;
+    return tx_stats_;
+}
+
+uint8_t can_base::GetTxPending() {
+    tool::critical_section cs;
+    return tx_count_ + static_cast<uint8_t>(std::popcount(tx_mailbox_busy_));
+}
+
+bool can_base::IsTxPending() const {
+    tool::critical_section cs;
+    if (id_in_mailbox(tx_id_)) {
+        return true;
+    }
+    for (uint8_t i = 0; i < tx_count_; ++i) {
+        if (tx_queue_[i].id == tx_id_) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void can_base::enqueue(const can_tx_frame& frame, bool requeue) {
+    // 新帧排在同ID帧之后发送;重新入队的帧原本先到,排在同ID帧之前发送
+    uint8_t pos = 0;
+    while (pos < tx_count_
+           && (tx_queue_[pos].id > frame.id || (requeue && tx_queue_[pos].id == frame.id))) {
+        ++pos;
+    }
+    for (uint8_t i = tx_count_; i > pos; --i) {
+        tx_queue_[i] = tx_queue_[i - 1];
+    }
+    tx_queue_[pos] = frame;
+    ++tx_count_;
+    if (tx_count_ > tx_stats_.queue_peak) {
+        tx_stats_.queue_peak = tx_count_;
+    }
+}
+
+can_tx_frame can_base::dequeue(uint8_t index) {
+    can_tx_frame frame = tx_queue_[index];
+    --tx_count_;
+    for (uint8_t i = index; i < tx_count_; ++i) {
+        tx_queue_[i] = tx_queue_[i + 1];
+    }
+    return frame;
+}
 
-// 自定义中断处理函数
-void CAN_Rx_IRQHandler(CAN_HandleTypeDef* hcan, uint32_t fifox) {
-    CAN_RxHeaderTypeDef rx_header;
-    uint8_t rx_data[8];
+bool can_base::make_room(uint32_t id, uint8_t limit) {
+    while (tx_count_ >= limit) {
+        // 队首为优先级最低(ID最大)的帧,同ID时为最后入队的一帧
+        if (id >= tx_queue_[0].id) {
+            return false;
+        }
+        dequeue(0);
+        ++tx_stats_.dropped;
+    }
+    return true;
+}
+
+bool can_base::id_in_mailbox(uint32_t id) {
+    for (uint32_t mailbox = 0; mailbox < TX_MAILBOXES; ++mailbox) {
+        if ((tx_mailbox_busy_ & (1U << mailbox)) != 0U && tx_mailbox_frames_[mailbox].id == id) {
+            return true;
+        }
+    }
+    return false;
+}
 
-    if (HAL_CAN_GetRxMessage(hcan, fifox, &rx_header, rx_data) == HAL_OK) {
-        can_base* instance = can_base::get_instance(hcan, rx_header.StdId);
+int can_base::next_loadable() {
+    // 从队尾向前找第一个ID不在邮箱中的帧,即可装入的优先级最高、同ID中最先入队的帧
+    for (int i = tx_count_ - 1; i >= 0; --i) {
+        if (!id_in_mailbox(tx_queue_[i].id)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+void can_base::load_mailbox(uint32_t mailbox, const can_tx_frame& frame) {
+    uint32_t low  = 0;
+    uint32_t high = 0;
+    std::memcpy(&low, frame.data, sizeof(low));
+    std::memcpy(&high, frame.data + sizeof(low), sizeof(high));
+
+    CAN_TxMailBox_TypeDef& box = hcan.Instance->sTxMailBox[mailbox];
+    box.TIR                    = frame.id << CAN_TI0R_STID_Pos; // 标准数据帧
+    box.TDTR                   = frame.length;
+    box.TDLR                   = low;
+    box.TDHR                   = high;
+    box.TIR                    = box.TIR | CAN_TI0R_TXRQ;
+
+    tx_mailbox_frames_[mailbox] = frame;
+    tx_mailbox_busy_ |= 1U << mailbox;
+}
+
+void can_base::fill_mailboxes() {
+    if (hcan.State != HAL_CAN_STATE_LISTENING) {
+        return; // 未启动时帧留在队列中
+    }
+    uint32_t tsr = hcan.Instance->TSR;
+    for (uint32_t mailbox = 0; mailbox < TX_MAILBOXES; ++mailbox) {
+        bool empty = (tsr & (CAN_TSR_TME0 << mailbox)) != 0U;
+        if (empty && (tx_mailbox_busy_ & (1U << mailbox)) == 0U) {
+            int next = next_loadable();
+            if (next < 0) {
+                return;
+            }
+            load_mailbox(mailbox, dequeue(static_cast<uint8_t>(next)));
+        }
+    }
+}
+
+void can_base::preempt_mailbox() {
+    // 邮箱全满且可装入的最高优先级帧优先于邮箱中最低优先级的帧时中止后者;同一时间只中止一个,
+    // 并为被中止的帧预留队列位置
+    if (tx_preempt_mailbox_ >= 0 || tx_count_ == TX_QUEUE_SIZE
+        || tx_mailbox_busy_ != (1U << TX_MAILBOXES) - 1U) {
+        return;
+    }
+    int next = next_loadable();
+    if (next < 0) {
+        return;
+    }
+    uint32_t victim = 0;
+    for (uint32_t mailbox = 1; mailbox < TX_MAILBOXES; ++mailbox) {
+        if (tx_mailbox_frames_[mailbox].id > tx_mailbox_frames_[victim].id) {
+            victim = mailbox;
+        }
+    }
+    if (tx_queue_[next].id >= tx_mailbox_frames_[victim].id) {
+        return;
+    }
+    tx_preempt_mailbox_ = static_cast<int8_t>(victim);
+    // TSR的其余位写1清除,只写ABRQ位;正在总线上发送的帧无法中止,会正常完成
+    hcan.Instance->TSR = CAN_TSR_ABRQ0 << (victim * 8U);
+}
+
+void can_base::service_tx(int completed) {
+    tool::critical_section cs; // 更高优先级的中断也可能调用Transmit
+    if (completed >= 0) {
+        tx_mailbox_busy_ &= ~(1U << completed);
+        ++tx_stats_.sent;
+        bus_bits_ += frame_bits(tx_mailbox_frames_[completed].length);
+        bus_off_backoff_ = BUS_OFF_BACKOFF_MIN;
+    }
+    uint32_t tsr = hcan.Instance->TSR;
+    for (uint32_t mailbox = 0; mailbox < TX_MAILBOXES; ++mailbox) {
+        bool busy     = (tx_mailbox_busy_ & (1U << mailbox)) != 0U;
+        bool empty    = (tsr & (CAN_TSR_TME0 << mailbox)) != 0U;
+        bool reported = (tsr & (CAN_TSR_RQCP0 << (mailbox * 8U))) == 0U;
+        if (busy && empty && reported) {
+            // 已结束但未报告成功: 被中止或出错,帧没有发出
+            tx_mailbox_busy_ &= ~(1U << mailbox);
+            if (make_room(tx_mailbox_frames_[mailbox].id, TX_QUEUE_SIZE)) {
+                enqueue(tx_mailbox_frames_[mailbox], true);
+                ++tx_stats_.requeued;
+            } else {
+                ++tx_stats_.dropped;
+            }
+        }
+    }
+    if (tx_preempt_mailbox_ >= 0 && (tx_mailbox_busy_ & (1U << tx_preempt_mailbox_)) == 0U) {
+        tx_preempt_mailbox_ = -1;
+    }
+    fill_mailboxes();
+    preempt_mailbox();
+}
+
+bool can_base::SetBitrate(can_bitrate bitrate) {
+    if (started_) {
+        return false;
+    }
+    can_bit_timing timing   = can_timing(bitrate);
+    hcan.Init.Prescaler     = timing.prescaler;
+    hcan.Init.TimeSeg1      = timing.TimeSeg1();
+    hcan.Init.TimeSeg2      = timing.TimeSeg2();
+    hcan.Init.SyncJumpWidth = timing.SyncJumpWidth();
+    // HAL_CAN_Init只在RESET/READY状态下进入初始化模式并重写BTR,未启动时外设处于READY
+    return HAL_CAN_Init(&hcan) == HAL_OK;
+}
+
+uint32_t can_base::GetBitrate() {
+    uint32_t btr       = hcan.Instance->BTR;
+    uint32_t prescaler = ((btr & CAN_BTR_BRP) >> CAN_BTR_BRP_Pos) + 1U;
+    uint32_t ts1       = ((btr & CAN_BTR_TS1) >> CAN_BTR_TS1_Pos) + 1U;
+    uint32_t ts2       = ((btr & CAN_BTR_TS2) >> CAN_BTR_TS2_Pos) + 1U;
+    return HAL_RCC_GetPCLK1Freq() / (prescaler * (1U + ts1 + ts2));
+}
+
+can_bus_stats can_base::GetBusStats() {
+    tool::critical_section cs;
+    return bus_stats_;
+}
+
+void can_base::ResetBusStats() {
+    tool::critical_section cs;
+    bus_stats_ = {};
+}
+
+void can_base::dispatch_error(uint32_t error_code) {
+    update_bus_state(hcan.Instance->ESR);
+
+    // 最近错误码每次错误帧只报告一种
+    if (error_code & HAL_CAN_ERROR_STF) {
+        ++bus_stats_.stuff_errors;
+    }
+    if (error_code & HAL_CAN_ERROR_FOR) {
+        ++bus_stats_.form_errors;
+    }
+    if (error_code & HAL_CAN_ERROR_ACK) {
+        ++bus_stats_.ack_errors;
+    }
+    if (error_code & HAL_CAN_ERROR_BR) {
+        ++bus_stats_.bit_recessive_errors;
+    }
+    if (error_code & HAL_CAN_ERROR_BD) {
+        ++bus_stats_.bit_dominant_errors;
+    }
+    if (error_code & HAL_CAN_ERROR_CRC) {
+        ++bus_stats_.crc_errors;
+    }
+    if (error_code & HAL_CAN_ERROR_RX_FOV0) {
+        ++bus_stats_.fifo_overruns[CAN_RX_FIFO0];
+    }
+    if (error_code & HAL_CAN_ERROR_RX_FOV1) {
+        ++bus_stats_.fifo_overruns[CAN_RX_FIFO1];
+    }
+    if (error_code & (HAL_CAN_ERROR_TX_ALST0 | HAL_CAN_ERROR_TX_ALST1 | HAL_CAN_ERROR_TX_ALST2)) {
+        ++bus_stats_.arbitration_lost;
+    }
+    if (error_code & (HAL_CAN_ERROR_TX_TERR0 | HAL_CAN_ERROR_TX_TERR1 | HAL_CAN_ERROR_TX_TERR2)) {
+        ++bus_stats_.tx_errors;
+    }
+}
+
+void can_base::update_bus_state(uint32_t esr) {
+    bus_stats_.tec = static_cast<uint8_t>((esr & CAN_ESR_TEC) >> CAN_ESR_TEC_Pos);
+    bus_stats_.rec = static_cast<uint8_t>((esr & CAN_ESR_REC) >> CAN_ESR_REC_Pos);
+
+    can_bus_state state = (esr & CAN_ESR_BOFF)   ? can_bus_state::bus_off
+                          : (esr & CAN_ESR_EPVF) ? can_bus_state::error_passive
+                          : (esr & CAN_ESR_EWGF) ? can_bus_state::error_warning
+                                                 : can_bus_state::error_active;
+    if (state == bus_state_) {
+        return;
+    }
+    if (state > bus_state_) {
+        switch (state) {
+        case can_bus_state::error_warning: ++bus_stats_.error_warnings; break;
+        case can_bus_state::error_passive: ++bus_stats_.error_passives; break;
+        case can_bus_state::bus_off:
+            ++bus_stats_.bus_offs;
+            // 未开启自动离线管理,需软件进出初始化模式后硬件才开始恢复流程,退避后由监视守护执行
+            bus_monitor_.StartOnce(bus_off_backoff_);
+            bus_off_backoff_ = bus_off_backoff_ * 2 > BUS_OFF_BACKOFF_MAX
+                                   ? dwt::clock::duration(BUS_OFF_BACKOFF_MAX)
+                                   : bus_off_backoff_ * 2;
+            break;
+        default: break;
+        }
+    } else if (bus_state_ == can_bus_state::bus_off) {
+        ++bus_stats_.recoveries;
+    }
+    // 单独在线或总线异常时每次重发都会产生错误帧,错误被动及以上关闭LEC中断避免中断风暴,
+    // 状态回落后由监视守护重新打开
+    if (state >= can_bus_state::error_passive) {
+        hcan.Instance->IER = hcan.Instance->IER & ~CAN_IT_LAST_ERROR_CODE;
+    } else {
+        hcan.Instance->IER = hcan.Instance->IER | CAN_IT_LAST_ERROR_CODE;
+    }
+    bus_state_ = state;
+}
+
+void can_base::monitor_bus() {
+    if (!started_) {
+        return;
+    }
+    bool recovering  = bus_monitor_.IsPaused(); // 单次定时触发即为离线恢复
+    CAN_TypeDef* can = hcan.Instance;
+    if (recovering) {
+        // 进入再退出初始化模式,硬件随后等待128次11个隐性位后回到主动错误状态
+        if (init_polls_ == 0 && (can->ESR & CAN_ESR_BOFF) != 0U) {
+            {
+                tool::critical_section cs;
+                can->MCR = can->MCR | CAN_MCR_INRQ;
+            }
+            init_polls_ = 1;
+            bus_monitor_.StartOnce(INIT_POLL_PERIOD);
+            return;
+        }
+        if (init_polls_ != 0) {
+            if ((can->MSR & CAN_MSR_INAK) == 0U && init_polls_ < INIT_POLL_LIMIT) {
+                ++init_polls_;
+                bus_monitor_.StartOnce(INIT_POLL_PERIOD);
+                return;
+            }
+            tool::critical_section cs;
+            can->MCR    = can->MCR & ~CAN_MCR_INRQ;
+            init_polls_ = 0;
+        }
+    }
+    {
+        tool::critical_section cs;
+        update_bus_state(can->ESR);
+
+        auto now     = dwt::clock::now();
+        auto elapsed = (now - bus_sampled_at_).count();
+        uint64_t bitrate = GetBitrate();
+        if (bus_sampled_at_ != dwt::clock::time_point{} && elapsed > 0) {
+            // 位数 / (波特率 * 时长),时长以CPU周期计
+            auto load = static_cast<uint16_t>(static_cast<uint64_t>(bus_bits_) * 1000U
+                                              * dwt::cpu_freq_hz / (bitrate * elapsed));
+            bus_stats_.bus_load_permille = load;
+            if (load > bus_stats_.bus_load_peak) {
+                bus_stats_.bus_load_peak = load;
+            }
+        }
+        bus_bits_       = 0;
+        bus_sampled_at_ = now;
+    }
+    if (recovering) {
+        bus_monitor_.SetDt(MONITOR_PERIOD);
+        bus_monitor_.Resume();
+    }
+}
+
+void can_base::drain_rx(uint32_t fifo) {
+    CAN_TypeDef* can       = hcan.Instance;
+    volatile uint32_t& rfr = fifo == CAN_RX_FIFO0 ? can->RF0R : can->RF1R;
+    // 一次中断取空FIFO(最多3帧),避免突发时每帧一次中断进出导致FIFO溢出
+    while ((rfr & CAN_RF0R_FMP0) != 0U) {
+        const CAN_FIFOMailBox_TypeDef& mailbox = can->sFIFOMailBox[fifo];
+        uint8_t head                           = rx_head_.load(std::memory_order_relaxed);
+        uint8_t depth = static_cast<uint8_t>(head - rx_tail_.load(std::memory_order_acquire));
+        if (depth >= RX_RING_SIZE) {
+            ++rx_stats_.ring_overruns;
+            rfr = CAN_RF0R_RFOM0;
+            continue;
+        }
+        can_rx_frame& frame = rx_ring_[head & (RX_RING_SIZE - 1)];
+        uint32_t rdtr       = mailbox.RDTR;
+        uint32_t low        = mailbox.RDLR;
+        uint32_t high       = mailbox.RDHR;
+        frame.timestamp     = DWT_GetCycles64();
+        frame.id            = (mailbox.RIR & CAN_RI0R_STID) >> CAN_RI0R_STID_Pos;
+        frame.fifo          = static_cast<uint8_t>(fifo);
+        frame.filter_match_index =
+            static_cast<uint8_t>((rdtr & CAN_RDT0R_FMI) >> CAN_RDT0R_FMI_Pos);
+        auto length  = static_cast<uint8_t>((rdtr & CAN_RDT0R_DLC) >> CAN_RDT0R_DLC_Pos);
+        frame.length = length > 8U ? 8U : length;
+        std::memcpy(frame.data, &low, sizeof(low));
+        std::memcpy(frame.data + sizeof(low), &high, sizeof(high));
+        rfr = CAN_RF0R_RFOM0; // 释放邮箱,其余位写0不影响
+
+        rx_head_.store(head + 1, std::memory_order_release);
+        bus_bits_ += frame_bits(frame.length);
+        ++rx_stats_.received;
+        if (depth + 1U > rx_stats_.ring_peak) {
+            rx_stats_.ring_peak = static_cast<uint8_t>(depth + 1U);
+        }
+        IRQ_TRACE_DISPATCH();
+    }
+    sleep::Notify();
+}
+
+void can_base::ProcessRx() {
+    uint8_t tail = rx_tail_.load(std::memory_order_relaxed);
+    while (tail != rx_head_.load(std::memory_order_acquire)) {
+        const can_rx_frame& frame = rx_ring_[tail & (RX_RING_SIZE - 1)];
+        can_base* instance        = get_instance(frame.fifo, frame.filter_match_index);
         if (instance) {
-            instance->OnRxInterruptCallback(rx_data, rx_header.DLC);
+            auto latency = static_cast<uint32_t>(DWT_GetCycles64() - frame.timestamp);
+            {
+                tool::critical_section cs;
+                if (latency > rx_stats_.latency_max) {
+                    rx_stats_.latency_max = latency;
+                }
+            }
+            instance->OnRxCallback(frame);
         }
+        // 回调返回后再释放该槽位,回调期间frame保持有效
+        rx_tail_.store(++tail, std::memory_order_release);
     }
 }
 
+can_rx_stats can_base::GetRxStats() {
+    tool::critical_section cs;
+    return rx_stats_;
+}
+
 } // namespace bsp
 
 extern "C" void HAL_CAN_RxFifo0MsgPendingCallback(CAN_HandleTypeDef* hcan) {
-    bsp::CAN_Rx_IRQHandler(hcan, CAN_RX_FIFO0);
+    bsp::can_base::drain_rx(CAN_RX_FIFO0);
 }
 
 extern "C" void HAL_CAN_RxFifo1MsgPendingCallback(CAN_HandleTypeDef* hcan) {
-    bsp::CAN_Rx_IRQHandler(hcan, CAN_RX_FIFO1);
-}
\ No newline at end of file
+    bsp::can_base::drain_rx(CAN_RX_FIFO1);
+}
+
+// 邮箱的完成、中止和出错都在发送中断中回收,随后从软件队列补充
+extern "C" void HAL_CAN_TxMailbox0CompleteCallback(CAN_HandleTypeDef* hcan) {
+    bsp::can_base::service_tx(0);
+}
+extern "C" void HAL_CAN_TxMailbox1CompleteCallback(CAN_HandleTypeDef* hcan) {
+    bsp::can_base::service_tx(1);
+}
+extern "C" void HAL_CAN_TxMailbox2CompleteCallback(CAN_HandleTypeDef* hcan) {
+    bsp::can_base::service_tx(2);
+}
+extern "C" void HAL_CAN_TxMailbox0AbortCallback(CAN_HandleTypeDef* hcan) {
+    bsp::can_base::service_tx(-1);
+}
+extern "C" void HAL_CAN_TxMailbox1AbortCallback(CAN_HandleTypeDef* hcan) {
+    bsp::can_base::service_tx(-1);
+}
+extern "C" void HAL_CAN_TxMailbox2AbortCallback(CAN_HandleTypeDef* hcan) {
+    bsp::can_base::service_tx(-1);
+}
+extern "C" void HAL_CAN_ErrorCallback(CAN_HandleTypeDef* hcan) {
+    // HAL只累加错误码,分类后清除,避免下次回调重复计数
+    bsp::can_base::dispatch_error(hcan->ErrorCode);
+    HAL_CAN_ResetError(hcan);
+    bsp::can_base::service_tx(-1);
+}
+
+#if BSP_FAST_IRQ_ENABLED
+
+extern "C" bool BSP_FastIRQ_CAN_RX(CAN_HandleTypeDef* hcan, uint32_t fifo) {
+    const volatile uint32_t& rfr = fifo == CAN_RX_FIFO0 ? hcan->Instance->RF0R
+                                                        : hcan->Instance->RF1R;
+    if ((rfr & CAN_RF0R_FMP0) == 0U) {
+        return false; // 没有挂起的报文,可能是满/溢出中断,交回HAL
+    }
+    bsp::can_base::drain_rx(fifo);
+    return true;
+}
+
+#endif
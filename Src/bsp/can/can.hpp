@@ -1,50 +1,162 @@
 #pragma once
 
+#include "bsp/dwt/dwt.h"
+#include "bsp/fast_irq/fast_irq.h"
+#include "can_timing.hpp"
+#include "tool/registry.hpp"
+
 #include <can.h>
 
+#include <atomic>
+#include <chrono>
 #include <cstdint>
 
 namespace bsp {
 
+// 标准ID的接收订阅,mask中为1的位参与比较;默认精确匹配,只接收标准数据帧
+struct can_filter {
+    uint16_t id   = 0;
+    uint16_t mask = 0x7FF;
+    uint8_t load  = 1; // 预期报文频率的相对权重,用于在两个接收FIFO之间均衡
+
+    [[nodiscard]] constexpr bool IsExact() const { return mask == 0x7FF; }
+};
+
+struct can_tx_frame {
+    uint32_t id;
+    uint8_t length;
+    uint8_t data[8];
+};
+
+struct can_tx_stats {
+    uint32_t sent;      // 发送成功的帧
+    uint32_t dropped;   // 软件队列满时丢弃的新帧,或为更高优先级的帧让位而挤掉的最低优先级帧
+    uint32_t requeued;  // 为更高优先级帧让出邮箱或发送出错而重新排队的帧
+    uint8_t queue_peak; // 软件队列的最大深度
+};
+
+// 接收中断取出的一帧,timestamp为取出时的DWT周期数
+struct can_rx_frame {
+    uint64_t timestamp;
+    uint32_t id;
+    uint8_t fifo;
+    uint8_t filter_match_index;
+    uint8_t length;
+    uint8_t data[8];
+};
+
+struct can_rx_stats {
+    uint32_t received;       // 进入接收环的帧
+    uint32_t ring_overruns;  // 接收环满而丢弃的帧
+    uint8_t ring_peak;       // 接收环的最大深度
+    uint32_t latency_max;    // 从中断取出到回调执行的最大周期数
+};
+
+// 错误状态由ESR的EWGF/EPVF/BOFF得出,严重程度递增
+enum class can_bus_state : uint8_t {
+    error_active,
+    error_warning,
+    error_passive,
+    bus_off,
+};
+
+struct can_bus_stats {
+    uint8_t tec;                   // 最近一次采样的发送错误计数
+    uint8_t rec;                   // 最近一次采样的接收错误计数
+    uint16_t bus_load_permille;    // 最近一个采样周期的总线负载
+    uint16_t bus_load_peak;        // 负载峰值,千分比
+    uint32_t error_warnings;       // 进入错误警告的次数
+    uint32_t error_passives;       // 进入错误被动的次数
+    uint32_t bus_offs;             // 进入离线的次数
+    uint32_t recoveries;           // 离线后恢复的次数
+    uint32_t stuff_errors;         // 以下为最近错误码(LEC)的分类计数
+    uint32_t form_errors;
+    uint32_t ack_errors;
+    uint32_t bit_recessive_errors;
+    uint32_t bit_dominant_errors;
+    uint32_t crc_errors;
+    uint32_t arbitration_lost;     // 发送邮箱仲裁失败
+    uint32_t tx_errors;            // 发送邮箱报告的发送错误
+    uint32_t fifo_overruns[2];     // 接收FIFO(3级)溢出,按FIFO计数
+};
+
 // 非模板基类
 class can_base {
 public:
-    virtual ~can_base() { unregister_instance(this); }
+    virtual ~can_base() {
+        remove_subscriptions(this);
+        can_instances_.Unregister(this);
+    }
 
-    // 纯虚函数，派生类需要实现
-    virtual void OnRxInterruptCallback(uint8_t* data, uint8_t length) = 0;
+    // 纯虚函数，派生类需要实现,在主循环中由ProcessRx调用
+    virtual void OnRxCallback(const can_rx_frame& frame) = 0;
 
+    // 订阅实例的接收ID并提交过滤器,第一个实例启动时启动CAN外设
     void Begin() {
-        AddFilters();
-        if (can_instance_count_ == 1) {
-            ServiceInit();
+        if (rx_id_ != 0) {
+            Subscribe(can_filter{.id = static_cast<uint16_t>(rx_id_)});
         }
-    }
-    // 发送 CAN 消息
-    void Transmit(uint8_t* tx_data, uint8_t length, uint32_t id = 0) {
-        CAN_TxHeaderTypeDef tx_header;
-        uint32_t tx_mailbox;
-
-        tx_header.StdId              = id != 0 ? id : tx_id_; // 发送ID
-        tx_header.RTR                = CAN_RTR_DATA;          // 数据帧
-        tx_header.IDE                = CAN_ID_STD;            // 标准帧
-        tx_header.DLC                = length;                // 数据长度
-        tx_header.TransmitGlobalTime = DISABLE;
-
-        if (HAL_CAN_AddTxMessage(can_handle_, &tx_header, tx_data, &tx_mailbox) != HAL_OK) {
-            // 发送错误处理
+        CommitFilters();
+        if (!started_) {
+            ServiceInit();
+            started_ = true;
         }
     }
+    /**
+     * @brief 增加一条接收订阅,启动后订阅会立即重新提交过滤器
+     * @return 订阅表满或同一过滤条件已被其他实例订阅时返回false;启动后提交时bank不足也返回false,
+     *         此时撤销该订阅,之前的订阅和过滤器不受影响
+     * @note 订阅范围重叠时报文只分发给一个实例: 精确ID优先于掩码范围,同类之间过滤器编号小者优先
+     */
+    bool Subscribe(const can_filter& filter);
+    /**
+     * @brief 按全部订阅重新分配并写入过滤器bank,结果只取决于订阅集合,与实例启动顺序无关
+     * @note 精确ID按16位列表模式每bank打包4个,掩码范围按16位掩码模式每bank打包2个,
+     *       RTR/IDE位参与比较;订阅按load在FIFO0/FIFO1之间贪心均衡。bank不足时返回false且不修改过滤器
+     */
+    static bool CommitFilters();
+    [[nodiscard]] static uint32_t GetFilterBankCount() { return filter_banks_used_; }
+    /**
+     * @brief 按编译期求得的位时序重新初始化外设,须在第一个实例Begin之前调用,总线上所有节点须一致
+     * @return 外设已启动或初始化失败时返回false
+     * @note 覆盖MX_CAN_Init写入的CubeMX位时序(36/3/4,采样点50%),调用后以can_timing表为准
+     */
+    static bool SetBitrate(can_bitrate bitrate);
+    // 按BTR寄存器计算当前波特率
+    [[nodiscard]] static uint32_t GetBitrate();
+    /**
+     * @brief 总线错误与负载统计
+     * @note TEC/REC和负载每秒采样一次;负载按本节点收发及通过过滤器的帧估算,不计位填充,为下限
+     */
+    [[nodiscard]] static can_bus_stats GetBusStats();
+    [[nodiscard]] static can_bus_state GetBusState() { return bus_state_; }
+    static void ResetBusStats();
+    /**
+     * @brief 发送标准数据帧,id为0时使用实例的发送ID
+     * @note 帧进入按ID排序的软件队列(ID越小越先发),有空闲邮箱时立即装入,其余在发送邮箱空中断中补充;
+     *       同ID的帧按调用先后发送。队列满时若该帧优先于队列中优先级最低的帧则挤掉后者,
+     *       否则丢弃该帧并返回false。可在中断中调用
+     */
+    bool Transmit(const uint8_t* tx_data, uint8_t length, uint32_t id = 0);
 
-    // 查找实例
-    static can_base* get_instance(CAN_HandleTypeDef* hcan, uint32_t rx_id) {
-        for (size_t i = 0; i < can_instance_count_; ++i) {
-            if (can_instances_[i]->can_handle_ == hcan && can_instances_[i]->rx_id_ == rx_id) {
-                return can_instances_[i];
-            }
-        }
-        return nullptr;
+    [[nodiscard]] static can_tx_stats GetTxStats();
+    [[nodiscard]] static uint8_t GetTxPending();
+    // 本实例发送ID的帧仍在软件队列或发送邮箱中
+    [[nodiscard]] bool IsTxPending() const;
+
+    /**
+     * @brief 在主循环中调用: 依次取出接收环中的帧,按FIFO和过滤器匹配序号分发给实例
+     * @note 中断只负责取空FIFO并记录时间戳,实例的回调和其中的状态修改都在线程上下文中完成
+     */
+    static void ProcessRx();
+    [[nodiscard]] static can_rx_stats GetRxStats();
+
+    // 按接收FIFO和过滤器匹配序号(rx_header.FilterMatchIndex)查找实例
+    static can_base* get_instance(uint32_t fifo, uint32_t filter_match_index) {
+        return can_instances_.Find(instance_key(fifo, filter_match_index));
     }
+    // HAL和快速中断路径共用: 取空接收FIFO,每帧打上时间戳后放入接收环
+    static void drain_rx(uint32_t fifo);
 
 protected:
     CAN_HandleTypeDef* can_handle_;
@@ -54,78 +166,124 @@ protected:
     can_base(CAN_HandleTypeDef* _hcan, uint32_t _tx_id, uint32_t _rx_id)
         : can_handle_(_hcan)
         , tx_id_(_tx_id)
-        , rx_id_(_rx_id) {
-        register_instance(this);
-    }
+        , rx_id_(_rx_id) {}
 
-    void AddFilters() {
-        CAN_FilterTypeDef filter;
-        filter.FilterIdHigh     = (rx_id_ << 5) & 0xFFFF; // 标准ID位于位15:5
-        filter.FilterIdLow      = 0x0000;
-        filter.FilterMaskIdHigh = 0xFFFF;                 // 精确匹配ID
-        filter.FilterMaskIdLow  = 0x0000;
-        filter.FilterFIFOAssignment =
-            (rx_id_ & 1) ? CAN_RX_FIFO0 : CAN_RX_FIFO1;   // 奇数ID -> FIFO0, 偶数ID -> FIFO1
-        filter.FilterBank =
-            static_cast<uint32_t>(can_instance_count_ - 1); // 每个实例使用不同的过滤器bank
-        filter.FilterMode       = CAN_FILTERMODE_IDMASK;
-        filter.FilterScale      = CAN_FILTERSCALE_32BIT;
-        filter.FilterActivation = ENABLE;
-
-        if (HAL_CAN_ConfigFilter(can_handle_, &filter) != HAL_OK) {
-            // 过滤器配置错误处理
-        }
-    }
     static void ServiceInit() {
         if (HAL_CAN_Start(&hcan) != HAL_OK) {
             // 启动错误处理
         }
         if (HAL_CAN_ActivateNotification(
-                &hcan, CAN_IT_RX_FIFO0_MSG_PENDING | CAN_IT_RX_FIFO1_MSG_PENDING)
+                &hcan, CAN_IT_RX_FIFO0_MSG_PENDING | CAN_IT_RX_FIFO1_MSG_PENDING
+                           | CAN_IT_TX_MAILBOX_EMPTY | CAN_IT_RX_FIFO0_OVERRUN
+                           | CAN_IT_RX_FIFO1_OVERRUN | CAN_IT_ERROR_WARNING
+                           | CAN_IT_ERROR_PASSIVE | CAN_IT_BUSOFF | CAN_IT_LAST_ERROR_CODE
+                           | CAN_IT_ERROR)
             != HAL_OK) {
             // 中断激活错误处理
         }
     }
 
-    // 注册和注销实例
-    static void register_instance(can_base* instance) {
-        if (can_instance_count_ < MAX_CAN_INSTANCES) {
-            can_instances_[can_instance_count_++] = instance;
-        }
-    }
-
-    static void unregister_instance(can_base* instance) {
-        for (size_t i = 0; i < can_instance_count_; ++i) {
-            if (can_instances_[i] == instance) {
-                for (size_t j = i; j < can_instance_count_ - 1; ++j) {
-                    can_instances_[j] = can_instances_[j + 1];
-                }
-                can_instances_[can_instance_count_ - 1] = nullptr;
-                --can_instance_count_;
-                break;
-            }
-        }
+    static size_t instance_key(uint32_t fifo, uint32_t filter_match_index) {
+        return fifo * MAX_FILTER_NUMBERS + filter_match_index;
     }
 
 private:
-    static constexpr size_t MAX_CAN_INSTANCES = 14; // STM32F103 有 14 个过滤器
-    static can_base* can_instances_[MAX_CAN_INSTANCES];
-    static size_t can_instance_count_;
+    static constexpr uint32_t MAX_FILTER_BANKS   = 14; // STM32F103 有 14 个过滤器
+    static constexpr uint32_t MAX_FILTER_NUMBERS = 4 * MAX_FILTER_BANKS; // 每个FIFO的最大匹配序号数
+    static constexpr size_t MAX_SUBSCRIPTIONS    = 32;
+    // 键为 FIFO * MAX_FILTER_NUMBERS + 过滤器匹配序号
+    static tool::registry<can_base, 2 * MAX_FILTER_NUMBERS> can_instances_;
+
+    struct subscription {
+        can_filter filter;
+        can_base* owner;
+        uint8_t fifo;
+    };
+    static subscription subscriptions_[MAX_SUBSCRIPTIONS];
+    static uint8_t subscription_count_;
+    static uint32_t filter_banks_used_;
+    static bool started_;
+
+    static void remove_subscriptions(const can_base* owner);
+
+    // 发送队列按ID降序存放,队尾为下一帧,同ID按入队先后排列;三个邮箱中的帧另行记录,被中止时重新入队。
+    // 邮箱优先级按ID仲裁,同ID时按邮箱编号而非装入先后,因此邮箱中每个ID最多只放一帧,
+    // 同ID的下一帧等前一帧发出后再装入,中止重排也不会改变同ID帧的先后
+    static constexpr uint8_t TX_QUEUE_SIZE = 16;
+    static constexpr uint8_t TX_MAILBOXES  = 3;
+    static can_tx_frame tx_queue_[TX_QUEUE_SIZE];
+    static uint8_t tx_count_;
+    static can_tx_frame tx_mailbox_frames_[TX_MAILBOXES];
+    static uint8_t tx_mailbox_busy_; // 第n位表示邮箱n中有本驱动装入且尚未报告结束的帧
+    static int8_t tx_preempt_mailbox_; // 正在为高优先级帧中止的邮箱,-1表示没有
+    static can_tx_stats tx_stats_;
+
+    // 以下均需关中断或在CAN中断中调用
+    static void enqueue(const can_tx_frame& frame, bool requeue);
+    static can_tx_frame dequeue(uint8_t index);
+    // 队列长度达到limit时,若id优先于队首(优先级最低)的帧则将其挤掉,返回是否可以入队
+    static bool make_room(uint32_t id, uint8_t limit);
+    static bool id_in_mailbox(uint32_t id);
+    // 可装入邮箱的下一帧在队列中的下标,没有时返回-1
+    static int next_loadable();
+    static void load_mailbox(uint32_t mailbox, const can_tx_frame& frame);
+    static void fill_mailboxes();
+    static void preempt_mailbox();
+    // 发送中断中回收已结束的邮箱: completed为报告成功的邮箱,其余已空但未报告成功的帧重新入队
+    static void service_tx(int completed);
+
+    // 接收环,两个接收中断优先级相同互不抢占,视为单一生产者;主循环为唯一消费者
+    static constexpr uint8_t RX_RING_SIZE = 32;
+    static_assert((RX_RING_SIZE & (RX_RING_SIZE - 1)) == 0);
+    static can_rx_frame rx_ring_[RX_RING_SIZE];
+    static std::atomic<uint8_t> rx_head_;
+    static std::atomic<uint8_t> rx_tail_;
+    static can_rx_stats rx_stats_;
+
+    // 总线监视: 每秒采样错误计数和负载;离线时按退避时间(自BUS_OFF_BACKOFF_MIN起倍增)请求恢复,
+    // 成功发送一帧后退避时间复位。恢复分两次触发: 先请求进入初始化模式,INIT_POLL_PERIOD后
+    // 确认INAK再退出,不在临界区内忙等
+    class bus_monitor;
+    static constexpr auto MONITOR_PERIOD      = std::chrono::seconds(1);
+    static constexpr auto BUS_OFF_BACKOFF_MIN = std::chrono::milliseconds(100);
+    static constexpr auto BUS_OFF_BACKOFF_MAX = std::chrono::milliseconds(3200);
+    static constexpr auto INIT_POLL_PERIOD    = std::chrono::milliseconds(1);
+    static constexpr uint8_t INIT_POLL_LIMIT  = 10; // 超过后不再等INAK,直接退出初始化模式
+    static bus_monitor bus_monitor_;
+    static can_bus_state bus_state_;
+    static can_bus_stats bus_stats_;
+    static dwt::clock::duration bus_off_backoff_;
+    static uint8_t init_polls_; // 已请求进入初始化模式后的检查次数,0表示未请求
+    static uint32_t bus_bits_; // 上次采样以来收发的位数
+    static dwt::clock::time_point bus_sampled_at_;
+
+    static constexpr uint32_t frame_bits(uint8_t length) { return 47U + 8U * length; }
+    // CAN中断中调用: 按HAL错误码分类计数并更新错误状态
+    static void dispatch_error(uint32_t error_code);
+    // 需关中断或在CAN中断中调用: 按ESR更新错误状态,计数状态升级,错误被动及以上时关闭LEC中断
+    static void update_bus_state(uint32_t esr);
+    // 监视守护回调,在主循环中执行
+    static void monitor_bus();
 
-    // 友元函数，用于中断处理
-    friend void CAN_Rx_IRQHandler(CAN_HandleTypeDef* hcan);
+    friend void ::HAL_CAN_TxMailbox0CompleteCallback(CAN_HandleTypeDef* hcan);
+    friend void ::HAL_CAN_TxMailbox1CompleteCallback(CAN_HandleTypeDef* hcan);
+    friend void ::HAL_CAN_TxMailbox2CompleteCallback(CAN_HandleTypeDef* hcan);
+    friend void ::HAL_CAN_TxMailbox0AbortCallback(CAN_HandleTypeDef* hcan);
+    friend void ::HAL_CAN_TxMailbox1AbortCallback(CAN_HandleTypeDef* hcan);
+    friend void ::HAL_CAN_TxMailbox2AbortCallback(CAN_HandleTypeDef* hcan);
+    friend void ::HAL_CAN_ErrorCallback(CAN_HandleTypeDef* hcan);
 };
 
 // 模板类，使用 CRTP 进行回调绑定
 template <typename Derived>
 class can : public can_base {
 public:
-    using CallbackFunction = void (Derived::*)(uint8_t* data, uint8_t length);
+    using CallbackFunction = void (Derived::*)(const can_rx_frame& frame);
 
     struct can_params {
         CAN_HandleTypeDef* can_handle = nullptr; // CAN句柄
         uint32_t tx_id                = 0;       // 发送ID
-        uint32_t rx_id                = 0;       // 接收ID
+        uint32_t rx_id                = 0;       // 接收ID,为0时不自动订阅,可用Subscribe添加
         Derived* callback_instance    = nullptr; // 回调实例
         CallbackFunction callback     = nullptr; // 回调函数
     };
@@ -136,9 +294,9 @@ public:
         , callback_function_(params.callback) {}
 
     // 实现基类的纯虚函数，调用上层类的回调
-    void OnRxInterruptCallback(uint8_t* data, uint8_t length) override {
+    void OnRxCallback(const can_rx_frame& frame) override {
         if (callback_instance_ && callback_function_) {
-            (callback_instance_->*callback_function_)(data, length);
+            (callback_instance_->*callback_function_)(frame);
         }
     }
 
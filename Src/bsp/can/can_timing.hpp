@@ -0,0 +1,120 @@
+#pragma once
+
+#include "bsp/dwt/dwt.h"
+
+#include <can.h>
+
+#include <cstdint>
+
+namespace bsp {
+
+// APB1 = HCLK / 2,须与SystemClock_Config中的APB1CLKDivider保持一致
+inline constexpr uint32_t can_clock_hz = DWT_CPU_FREQ_HZ / 2;
+
+/**
+ * @brief 总线波特率
+ * @note 8字节标准数据帧111位(最坏位填充约135位)在线上的时间,按位数计算,非实测:
+ *       125k 0.89~1.08ms, 250k 0.44~0.54ms, 500k 222~270us, 1M 111~135us;
+ *       接收端另加中断分发时间,可在开启IRQ_TRACE_ENABLED后从IRQ_Trace_Table读取
+ */
+enum class can_bitrate : uint32_t {
+    k125  = 125000,
+    k250  = 250000,
+    k500  = 500000,
+    k1000 = 1000000,
+};
+
+struct can_bit_timing {
+    uint16_t prescaler; // 1~1024
+    uint8_t bs1;        // 1~16 tq
+    uint8_t bs2;        // 1~8 tq
+    uint8_t sjw;        // 1~4 tq
+
+    [[nodiscard]] constexpr uint32_t Quanta() const { return 1U + bs1 + bs2; }
+    // 采样点位置,千分比
+    [[nodiscard]] constexpr uint32_t SamplePoint() const { return 1000U * (1U + bs1) / Quanta(); }
+    [[nodiscard]] constexpr uint32_t Bitrate(uint32_t clock_hz) const {
+        return clock_hz / (prescaler * Quanta());
+    }
+    // HAL的Init字段直接就是BTR中对应位段的值
+    [[nodiscard]] constexpr uint32_t TimeSeg1() const {
+        return static_cast<uint32_t>(bs1 - 1U) << CAN_BTR_TS1_Pos;
+    }
+    [[nodiscard]] constexpr uint32_t TimeSeg2() const {
+        return static_cast<uint32_t>(bs2 - 1U) << CAN_BTR_TS2_Pos;
+    }
+    [[nodiscard]] constexpr uint32_t SyncJumpWidth() const {
+        return static_cast<uint32_t>(sjw - 1U) << CAN_BTR_SJW_Pos;
+    }
+};
+
+namespace detail {
+// 非constexpr函数,在常量求值中调用即产生编译错误,错误信息中会出现该函数名
+inline void can_bit_timing_has_no_exact_solution() {}
+} // namespace detail
+
+/**
+ * @brief 编译期求解bxCAN位时序: 只接受能精确得到目标波特率的分频,在此基础上选择采样点最接近目标的
+ *        BS1/BS2,同等误差时取更多的时间份额(tq)以提高同步精度;SJW取min(4, BS2)
+ * @param clock_hz APB1时钟
+ * @param bitrate 目标波特率
+ * @param sample_point 目标采样点,千分比,CANopen推荐875
+ * @param tolerance 采样点允许的最大偏差,千分比
+ */
+consteval can_bit_timing solve_can_bit_timing(uint32_t clock_hz, uint32_t bitrate,
+                                              uint32_t sample_point = 875,
+                                              uint32_t tolerance    = 25) {
+    can_bit_timing best = {};
+    uint32_t best_error = UINT32_MAX;
+    for (uint32_t quanta = 25; quanta >= 8; --quanta) {
+        if (clock_hz % (bitrate * quanta) != 0) {
+            continue;
+        }
+        uint32_t prescaler = clock_hz / (bitrate * quanta);
+        if (prescaler < 1 || prescaler > 1024) {
+            continue;
+        }
+        for (uint32_t bs2 = 1; bs2 <= 8; ++bs2) {
+            uint32_t bs1 = quanta - 1 - bs2;
+            if (bs1 < 1 || bs1 > 16) {
+                continue;
+            }
+            uint32_t point = 1000 * (1 + bs1) / quanta;
+            uint32_t error = point > sample_point ? point - sample_point : sample_point - point;
+            if (error < best_error) {
+                best_error = error;
+                best       = {static_cast<uint16_t>(prescaler), static_cast<uint8_t>(bs1),
+                              static_cast<uint8_t>(bs2), static_cast<uint8_t>(bs2 < 4 ? bs2 : 4)};
+            }
+        }
+    }
+    if (best_error > tolerance) {
+        detail::can_bit_timing_has_no_exact_solution();
+    }
+    return best;
+}
+
+// 可在启动时选择的波特率对应的位时序,均在编译期求得;125k为18/13/2(采样点87.5%),
+// 与CubeMX生成的36/3/4(采样点50%)不同,以can_base::SetBitrate写入的为准
+inline constexpr can_bit_timing can_timing_125k =
+    solve_can_bit_timing(can_clock_hz, static_cast<uint32_t>(can_bitrate::k125));
+inline constexpr can_bit_timing can_timing_250k =
+    solve_can_bit_timing(can_clock_hz, static_cast<uint32_t>(can_bitrate::k250));
+inline constexpr can_bit_timing can_timing_500k =
+    solve_can_bit_timing(can_clock_hz, static_cast<uint32_t>(can_bitrate::k500));
+inline constexpr can_bit_timing can_timing_1m =
+    solve_can_bit_timing(can_clock_hz, static_cast<uint32_t>(can_bitrate::k1000));
+
+static_assert(can_timing_125k.Bitrate(can_clock_hz) == 125000);
+static_assert(can_timing_1m.Bitrate(can_clock_hz) == 1000000);
+
+constexpr can_bit_timing can_timing(can_bitrate bitrate) {
+    switch (bitrate) {
+    case can_bitrate::k250: return can_timing_250k;
+    case can_bitrate::k500: return can_timing_500k;
+    case can_bitrate::k1000: return can_timing_1m;
+    default: return can_timing_125k;
+    }
+}
+
+} // namespace bsp
@@ -0,0 +1,233 @@
+#include "isotp.hpp"
+#include "tool/deamon/daemon.hpp"
+
+#include <cstring>
+
+namespace bsp {
+
+namespace {
+enum frame_type : uint8_t {
+    single_frame      = 0x0,
+    first_frame       = 0x1,
+    consecutive_frame = 0x2,
+    flow_control      = 0x3,
+};
+} // namespace
+
+bool isotp_base::Send(const uint8_t* data, size_t length) {
+    if (length == 0 || length > tx_capacity_ || tx_state_ != tx_state::idle) {
+        return false;
+    }
+    uint8_t frame[8];
+    if (length <= 7) {
+        frame[0] = static_cast<uint8_t>(single_frame << 4 | length);
+        std::memcpy(frame + 1, data, length);
+        if (!can_.Transmit(frame, static_cast<uint8_t>(length + 1))) {
+            return false;
+        }
+        ++stats_.tx_messages;
+        return true;
+    }
+
+    std::memcpy(tx_buffer_, data, length);
+    frame[0] = static_cast<uint8_t>(first_frame << 4 | length >> 8);
+    frame[1] = static_cast<uint8_t>(length);
+    std::memcpy(frame + 2, data, 6);
+
+    if (!can_.Transmit(frame, sizeof(frame))) {
+        return false;
+    }
+    tx_length_     = length;
+    tx_sent_       = 6;
+    tx_sequence_   = 1;
+    tx_wait_count_ = 0;
+    tx_frame_time_ = clock::duration(uint64_t{WORST_FRAME_BITS} * dwt::cpu_freq_hz
+                                     / can_base::GetBitrate());
+    tx_start_      = clock::now();
+    tx_deadline_   = tool::deadline::After(N_BS_TIMEOUT);
+    tx_state_      = tx_state::wait_flow_control;
+    tool::daemon_base::RequestWakeup(tx_deadline_.At());
+    return true;
+}
+
+void isotp_base::Poll() {
+    if (rx_active_ && rx_deadline_.IsExpired()) {
+        rx_active_ = false;
+        ++stats_.rx_aborts;
+    }
+
+    while (true) {
+        if (tx_state_ == tx_state::wait_flow_control) {
+            if (tx_deadline_.IsExpired()) {
+                tx_state_ = tx_state::idle;
+                ++stats_.tx_aborts;
+            }
+            return;
+        }
+        if (tx_state_ != tx_state::sending) {
+            return;
+        }
+        auto now = clock::now();
+        if (now < tx_next_at_) {
+            tool::daemon_base::RequestWakeup(tx_next_at_);
+            return;
+        }
+        if (can_.IsTxPending()) {
+            // 上一个连续帧还没发出,约一帧时间后再补充
+            tool::daemon_base::RequestWakeup(now + tx_frame_time_);
+            return;
+        }
+
+        size_t chunk = tx_length_ - tx_sent_ < 7 ? tx_length_ - tx_sent_ : 7;
+        uint8_t frame[8];
+        frame[0] = static_cast<uint8_t>(consecutive_frame << 4 | tx_sequence_);
+        std::memcpy(frame + 1, tx_buffer_ + tx_sent_, chunk);
+        if (!can_.Transmit(frame, static_cast<uint8_t>(chunk + 1))) {
+            tool::daemon_base::RequestWakeup(now + tx_frame_time_);
+            return;
+        }
+        tx_sent_ += chunk;
+        tx_sequence_ = (tx_sequence_ + 1) & 0x0F;
+        tx_next_at_  = now + tx_st_min_;
+
+        if (tx_sent_ == tx_length_) {
+            tx_state_ = tx_state::idle;
+            ++stats_.tx_messages;
+            stats_.last_tx_bytes  = static_cast<uint32_t>(tx_length_);
+            stats_.last_tx_cycles = static_cast<uint32_t>((clock::now() - tx_start_).count());
+            return;
+        }
+        if (tx_block_remaining_ != 0 && --tx_block_remaining_ == 0) {
+            tx_deadline_ = tool::deadline::After(N_BS_TIMEOUT);
+            tx_state_    = tx_state::wait_flow_control;
+            tool::daemon_base::RequestWakeup(tx_deadline_.At());
+            return;
+        }
+    }
+}
+
+void isotp_base::on_frame(const can_rx_frame& frame) {
+    const uint8_t* data = frame.data;
+    uint8_t length      = frame.length;
+    if (length == 0) {
+        return;
+    }
+    switch (data[0] >> 4) {
+    case single_frame: {
+        size_t size = data[0] & 0x0F;
+        if (size == 0 || size > 7 || size + 1 > length) {
+            return;
+        }
+        if (rx_ready_ || size > rx_capacity_) {
+            ++stats_.rx_overflows;
+            return;
+        }
+        rx_active_ = false; // 单帧打断正在进行的接收
+        std::memcpy(rx_buffer_, data + 1, size);
+        rx_length_ = size;
+        rx_ready_  = true;
+        ++stats_.rx_messages;
+        break;
+    }
+    case first_frame: {
+        size_t size = static_cast<size_t>(data[0] & 0x0F) << 8 | data[1];
+        if (length < 8 || size < 8) {
+            return;
+        }
+        if (rx_ready_ || size > rx_capacity_) {
+            ++stats_.rx_overflows;
+            send_flow_control(overflow);
+            return;
+        }
+        std::memcpy(rx_buffer_, data + 2, 6);
+        rx_length_      = size;
+        rx_received_    = 6;
+        rx_sequence_    = 1;
+        rx_block_count_ = 0;
+        rx_active_      = true;
+        rx_deadline_    = tool::deadline::After(N_CR_TIMEOUT);
+        tool::daemon_base::RequestWakeup(rx_deadline_.At());
+        send_flow_control(clear_to_send);
+        break;
+    }
+    case consecutive_frame: {
+        if (!rx_active_) {
+            return;
+        }
+        if ((data[0] & 0x0F) != rx_sequence_) {
+            rx_active_ = false;
+            ++stats_.rx_aborts;
+            return;
+        }
+        size_t chunk = rx_length_ - rx_received_ < 7 ? rx_length_ - rx_received_ : 7;
+        if (static_cast<size_t>(length - 1) < chunk) {
+            rx_active_ = false;
+            ++stats_.rx_aborts;
+            return;
+        }
+        std::memcpy(rx_buffer_ + rx_received_, data + 1, chunk);
+        rx_received_ += chunk;
+        rx_sequence_ = (rx_sequence_ + 1) & 0x0F;
+        if (rx_received_ == rx_length_) {
+            rx_active_ = false;
+            rx_ready_  = true;
+            ++stats_.rx_messages;
+            return;
+        }
+        rx_deadline_ = tool::deadline::After(N_CR_TIMEOUT);
+        tool::daemon_base::RequestWakeup(rx_deadline_.At());
+        if (block_size_ != 0 && ++rx_block_count_ == block_size_) {
+            rx_block_count_ = 0;
+            send_flow_control(clear_to_send);
+        }
+        break;
+    }
+    case flow_control: {
+        if (tx_state_ != tx_state::wait_flow_control || length < 3) {
+            return;
+        }
+        switch (data[0] & 0x0F) {
+        case clear_to_send:
+            tx_block_remaining_ = data[1];
+            tx_st_min_          = decode_st_min(data[2]);
+            tx_next_at_         = clock::now();
+            tx_wait_count_      = 0;
+            tx_state_           = tx_state::sending; // 由随后的Poll发送
+            break;
+        case wait:
+            if (++tx_wait_count_ > MAX_WAIT_FRAMES) {
+                tx_state_ = tx_state::idle;
+                ++stats_.tx_aborts;
+                break;
+            }
+            tx_deadline_ = tool::deadline::After(N_BS_TIMEOUT);
+            tool::daemon_base::RequestWakeup(tx_deadline_.At());
+            break;
+        default: // 溢出或未知状态
+            tx_state_ = tx_state::idle;
+            ++stats_.tx_aborts;
+            break;
+        }
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+void isotp_base::send_flow_control(flow_status status) {
+    uint8_t frame[3] = {static_cast<uint8_t>(flow_control << 4 | status), block_size_, st_min_};
+    can_.Transmit(frame, sizeof(frame));
+}
+
+isotp_base::clock::duration isotp_base::decode_st_min(uint8_t st_min) {
+    if (st_min <= 0x7F) {
+        return std::chrono::milliseconds(st_min);
+    }
+    if (st_min >= 0xF1 && st_min <= 0xF9) {
+        return std::chrono::microseconds((st_min - 0xF0) * 100);
+    }
+    return std::chrono::milliseconds(0x7F); // 保留值按最大间隔处理
+}
+
+} // namespace bsp
@@ -0,0 +1,154 @@
+#pragma once
+
+#include "can.hpp"
+#include "tool/deadline.hpp"
+#include "tool/frame_view.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace bsp {
+
+struct isotp_stats {
+    uint32_t tx_messages;    // 发送完成的报文
+    uint32_t rx_messages;    // 接收完成的报文
+    uint32_t tx_aborts;      // 流控超时、溢出或等待次数过多而放弃的发送
+    uint32_t rx_aborts;      // 序号错误或连续帧超时而放弃的接收
+    uint32_t rx_overflows;   // 缓冲区不足或上一条未取走而拒绝的接收
+    uint32_t last_tx_bytes;  // 最近一次分段发送的长度
+    uint32_t last_tx_cycles; // 最近一次分段发送从首帧到最后一个连续帧入队的CPU周期
+};
+
+/**
+ * @brief ISO 15765-2 风格的分段传输(标准帧、正常寻址),单帧/首帧/连续帧/流控帧,报文最长4095字节
+ * @note 接收在主循环的can_base::ProcessRx中完成重组并回复流控帧,完整报文保留在缓冲区中直到Release;
+ *       发送由主循环的Poll按流控帧给出的块大小和STmin补充连续帧,每个传输同一时刻只有一个连续帧
+ *       在CAN软件队列或邮箱中,上一帧发出后才补充下一帧,不挤占其他报文的队列位置
+ * @note 吞吐量为计算值,未经实测(8字节标准数据帧111位,最坏位填充后135位): 上一帧发出前不补充,
+ *       Poll按最坏帧时间(125kbit/s下1.08ms)后重新检查,每个连续帧约占1.1ms,BS=0、STmin=0时
+ *       7字节/1.1ms约6.3kB/s;BS=8时每8帧多一次流控往返(流控帧0.57~0.7ms加接收端主循环延迟),
+ *       约9.5~10.5ms发56字节,约5.3~5.9kB/s;STmin不超过1ms时不改变上述结果。
+ *       总线上有其他报文时更低,实测值见GetStats()的last_tx_bytes/last_tx_cycles
+ */
+class isotp_base {
+public:
+    using clock = bsp::dwt::clock;
+
+    static constexpr size_t MAX_MESSAGE_SIZE = 4095;
+
+    struct isotp_params {
+        CAN_HandleTypeDef* can_handle = nullptr; // CAN句柄
+        uint32_t tx_id                = 0;       // 发送ID
+        uint32_t rx_id                = 0;       // 接收ID
+        uint8_t block_size            = 0;       // 本端接收时要求的块大小,0为不分块
+        uint8_t st_min                = 0;       // 本端接收时要求的连续帧间隔,按ISO 15765-2编码
+    };
+
+    virtual ~isotp_base() = default;
+
+    void Begin() { can_.Begin(); }
+
+    /**
+     * @brief 发送一条报文,不超过7字节时以单帧立即入队,否则复制到发送缓冲区后分段发送
+     * @return 上一次分段发送未结束、长度为0或超过缓冲区时返回false
+     */
+    bool Send(const uint8_t* data, size_t length);
+    // 推进分段发送并检查超时,在主循环中调用
+    void Poll();
+
+    [[nodiscard]] bool IsSending() const { return tx_state_ != tx_state::idle; }
+    // 有完整的接收报文
+    [[nodiscard]] bool Available() const { return rx_ready_; }
+    [[nodiscard]] tool::frame_view View() const {
+        return rx_ready_ ? tool::frame_view(rx_buffer_, rx_length_) : tool::frame_view();
+    }
+    // 取走报文,之后才能接收下一条
+    void Release() { rx_ready_ = false; }
+
+    [[nodiscard]] isotp_stats GetStats() const { return stats_; }
+
+protected:
+    isotp_base(const isotp_params& params, uint8_t* rx_buffer, size_t rx_capacity,
+               uint8_t* tx_buffer, size_t tx_capacity)
+        : can_(can<isotp_base>::can_params{
+              .can_handle        = params.can_handle,
+              .tx_id             = params.tx_id,
+              .rx_id             = params.rx_id,
+              .callback_instance = this,
+              .callback          = &isotp_base::on_frame,
+          })
+        , rx_buffer_(rx_buffer)
+        , rx_capacity_(rx_capacity)
+        , tx_buffer_(tx_buffer)
+        , tx_capacity_(tx_capacity)
+        , block_size_(params.block_size)
+        , st_min_(params.st_min) {}
+
+private:
+    enum class tx_state : uint8_t { idle, wait_flow_control, sending };
+    enum flow_status : uint8_t { clear_to_send = 0, wait = 1, overflow = 2 };
+
+    static constexpr uint8_t MAX_WAIT_FRAMES   = 8;   // 连续收到WAIT流控帧的上限
+    static constexpr uint32_t WORST_FRAME_BITS = 135; // 8字节标准数据帧最坏位填充后的位数
+    static constexpr auto N_BS_TIMEOUT         = std::chrono::milliseconds(1000);
+    static constexpr auto N_CR_TIMEOUT         = std::chrono::milliseconds(1000);
+
+    // 主循环中由can_base::ProcessRx调用
+    void on_frame(const can_rx_frame& frame);
+    void send_flow_control(flow_status status);
+    static clock::duration decode_st_min(uint8_t st_min);
+
+    can<isotp_base> can_;
+
+    uint8_t* rx_buffer_;
+    size_t rx_capacity_;
+    uint8_t* tx_buffer_;
+    size_t tx_capacity_;
+    uint8_t block_size_;
+    uint8_t st_min_;
+
+    // 收发状态均只在主循环中修改
+    bool rx_ready_              = false;
+    bool rx_active_             = false;
+    size_t rx_length_           = 0;
+    size_t rx_received_         = 0;
+    uint8_t rx_sequence_        = 0;
+    uint8_t rx_block_count_     = 0;
+    tool::deadline rx_deadline_ = {};
+
+    tx_state tx_state_             = tx_state::idle;
+    size_t tx_length_              = 0;
+    size_t tx_sent_                = 0;
+    uint8_t tx_sequence_           = 0;
+    uint8_t tx_block_remaining_    = 0;
+    uint8_t tx_wait_count_         = 0;
+    clock::duration tx_st_min_     = {};
+    clock::duration tx_frame_time_ = {}; // 当前波特率下一帧的最坏线上时间
+    clock::time_point tx_next_at_  = {};
+    clock::time_point tx_start_    = {};
+    tool::deadline tx_deadline_    = {};
+
+    isotp_stats stats_ = {};
+};
+
+/**
+ * @brief 带静态收发缓冲区的分段传输
+ * @tparam RxSize 接收重组缓冲区大小,超过的报文以溢出流控帧拒绝
+ * @tparam TxSize 发送缓冲区大小
+ */
+template <size_t RxSize, size_t TxSize>
+class isotp : public isotp_base {
+    static_assert(RxSize >= 8 && RxSize <= MAX_MESSAGE_SIZE);
+    static_assert(TxSize >= 8 && TxSize <= MAX_MESSAGE_SIZE);
+
+public:
+    explicit isotp(const isotp_params& params)
+        : isotp_base(params, rx_storage_, RxSize, tx_storage_, TxSize) {}
+
+private:
+    uint8_t rx_storage_[RxSize] = {};
+    uint8_t tx_storage_[TxSize] = {};
+};
+
+} // namespace bsp
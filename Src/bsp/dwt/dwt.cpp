@@ -8,58 +8,41 @@
  */
 
 #include "dwt.h"
+#include "dwt_extend.hpp"
 #include "stm32F1xx.h"
 
-static DWT_Time_t SysTime;
-static uint32_t CPU_FREQ_Hz, CPU_FREQ_Hz_ms, CPU_FREQ_Hz_us;
-static uint32_t CYCCNT_RountCount;
-static uint32_t CYCCNT_LAST;
-static uint64_t CYCCNT64;
+#include <atomic>
 
-/**
- * @brief 私有函数,用于检查DWT CYCCNT寄存器是否溢出,并更新CYCCNT_RountCount
- * @attention 此函数假设两次调用之间的时间间隔不超过一次溢出
- *
- * @note 更好的方案是为dwt的时间更新单独设置一个任务?
- *       不过,使用dwt的初衷是定时不被中断/任务等因素影响,因此该实现仍然有其存在的意义
- *
- */
-static void DWT_CNT_Update() {
-    /**
-     *bit_locker
-     *一个位锁，防止中断中调用DWTGetDeltaT或DWTGetTimeline函数更新DWT维护的时间时打断任务中
-     *的相同函数导致计数被重复更新，或引起错误的DWT溢出检测。
-     */
-    static volatile uint8_t bit_locker = 0;
-    if (!bit_locker) {
-        bit_locker                = 1;
-        volatile uint32_t cnt_now = DWT->CYCCNT;
-        if (cnt_now < CYCCNT_LAST)
-            CYCCNT_RountCount++;
-
-        CYCCNT_LAST = DWT->CYCCNT;
-        bit_locker  = 0;
-    }
+static uint32_t CPU_FREQ_Hz, CPU_FREQ_Hz_us;
+static float CPU_PERIOD_s, CPU_PERIOD_ms;
+
+// 已经过的半周期(2^31个周期)计数,扩展算法见dwt_extend.hpp
+static std::atomic<uint32_t> CYCCNT_HalfCount;
+static_assert(std::atomic<uint32_t>::is_always_lock_free);
+
+static uint64_t DWT_CNT_Update() {
+    return bsp::dwt::extend_cycles(CYCCNT_HalfCount, [] { return DWT->CYCCNT; });
 }
 
 void DWT_Init() {
     /* 使能DWT外设 */
-    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    CoreDebug->DEMCR = CoreDebug->DEMCR | CoreDebug_DEMCR_TRCENA_Msk;
 
     /* DWT CYCCNT寄存器计数清0 */
     DWT->CYCCNT = (uint32_t)0u;
+    CYCCNT_HalfCount.store(0, std::memory_order_relaxed);
 
     /* 使能Cortex-M DWT CYCCNT寄存器 */
-    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
-
-    CPU_FREQ_Hz       = HAL_RCC_GetHCLKFreq();
-    CPU_FREQ_Hz_ms    = CPU_FREQ_Hz / 1000;
-    CPU_FREQ_Hz_us    = CPU_FREQ_Hz / 1000000;
-    CYCCNT_RountCount = 0;
+    DWT->CTRL = DWT->CTRL | DWT_CTRL_CYCCNTENA_Msk;
 
-    DWT_CNT_Update();
+    CPU_FREQ_Hz    = HAL_RCC_GetHCLKFreq();
+    CPU_FREQ_Hz_us = CPU_FREQ_Hz / 1000000;
+    CPU_PERIOD_s   = 1.0f / (float)CPU_FREQ_Hz;
+    CPU_PERIOD_ms  = 1000.0f / (float)CPU_FREQ_Hz;
 }
 
+uint64_t DWT_GetCycles64(void) { return DWT_CNT_Update(); }
+
 float DWT_GetDeltaT(uint32_t* cnt_last) {
     volatile uint32_t cnt_now = DWT->CYCCNT;
     float dt                  = ((float)(cnt_now - *cnt_last)) / ((float)(CPU_FREQ_Hz));
@@ -80,54 +63,23 @@ double DWT_GetDeltaT64(uint32_t* cnt_last) {
     return dt;
 }
 
-void DWT_SysTimeUpdate(void) {
-    volatile uint32_t cnt_now = DWT->CYCCNT;
-    uint64_t CNT_TEMP1, CNT_TEMP2, CNT_TEMP3;
-
-    DWT_CNT_Update();
-
-    CYCCNT64   = (uint64_t)CYCCNT_RountCount * (uint64_t)UINT32_MAX + (uint64_t)cnt_now;
-    CNT_TEMP1  = CYCCNT64 / CPU_FREQ_Hz;
-    CNT_TEMP2  = CYCCNT64 - CNT_TEMP1 * CPU_FREQ_Hz;
-    SysTime.s  = (uint32_t)CNT_TEMP1;
-    SysTime.ms = (uint16_t)(CNT_TEMP2 / CPU_FREQ_Hz_ms);
-    CNT_TEMP3  = CNT_TEMP2 - SysTime.ms * CPU_FREQ_Hz_ms;
-    SysTime.us = (uint16_t)(CNT_TEMP3 / CPU_FREQ_Hz_us);
-}
-
-float DWT_GetTimeline_s(void) {
-    DWT_SysTimeUpdate();
+void DWT_SysTimeUpdate(void) { DWT_CNT_Update(); }
 
-    float DWT_Timelinef32 =
-        (float)SysTime.s + (float)SysTime.ms * 0.001f + (float)SysTime.us * 0.000001f;
+float DWT_GetTimeline_s(void) { return (float)DWT_CNT_Update() * CPU_PERIOD_s; }
 
-    return DWT_Timelinef32;
-}
-
-float DWT_GetTimeline_ms(void) {
-    DWT_SysTimeUpdate();
+float DWT_GetTimeline_ms(void) { return (float)DWT_CNT_Update() * CPU_PERIOD_ms; }
 
-    float DWT_Timelinef32 =
-        (float)SysTime.s * 1000.0f + (float)SysTime.ms + (float)SysTime.us * 0.001f;
+uint64_t DWT_GetTimeline_us(void) { return DWT_CNT_Update() / CPU_FREQ_Hz_us; }
 
-    return DWT_Timelinef32;
-}
+void DWT_Delay(float Delay) { DWT_Delay_cycles((uint64_t)(Delay * (float)CPU_FREQ_Hz)); }
 
-uint64_t DWT_GetTimeline_us(void) {
-    DWT_SysTimeUpdate();
+void DWT_Delay_cycles(uint64_t cycles) {
+    uint64_t tickstart = DWT_CNT_Update();
 
-    uint64_t DWT_Timelinef32 = SysTime.s * 1000000 + SysTime.ms * 1000 + SysTime.us;
-
-    return DWT_Timelinef32;
-}
-
-void DWT_Delay(float Delay) {
-    uint32_t tickstart = DWT->CYCCNT;
-    float wait         = Delay;
-
-    while ((float)(DWT->CYCCNT - tickstart) < wait * (float)CPU_FREQ_Hz)
+    while (DWT_CNT_Update() - tickstart < cycles)
         ;
 }
+
 float DWT_GetDeltaT_Expect(uint32_t* cnt_last, float expect) {
     float dt = DWT_GetDeltaT(cnt_last);
     if (dt < expect * 0.95) {
@@ -17,22 +17,22 @@ extern "C" {
 #endif
 #include "stdint.h"
 
-typedef struct {
-    uint32_t s;
-    uint16_t ms;
-    uint16_t us;
-} DWT_Time_t;
+/**
+ * @brief CPU(HCLK)频率,须与SystemClock_Config中的配置保持一致(HSE 8MHz x9)
+ *        编译期的周期/时间换算均基于该值
+ */
+#define DWT_CPU_FREQ_HZ 72000000U
 
 /**
- * @brief 该宏用于计算代码段执行时间,单位为秒/s,返回值为float类型
- *        首先需要创建一个float类型的变量,用于存储时间间隔
- *        计算得到的时间间隔同时还会通过RTT打印到日志终端,你也可以将你的dt变量添加到查看
+ * @brief 该宏用于计算代码段执行时间,单位为CPU周期,结果为uint64_t类型
+ *        首先需要创建一个uint64_t类型的变量,用于存储时间间隔
+ *        需要长期统计(最值、分布)时使用tool/profile中的TOOL_PROFILE_ZONE
  */
 #define TIME_ELAPSE(dt, code)                \
     do {                                     \
-        float tstart = DWT_GetTimeline_s();  \
+        uint64_t tstart = DWT_GetCycles64(); \
         code;                                \
-        (dt) = DWT_GetTimeline_s() - tstart; \
+        (dt) = DWT_GetCycles64() - tstart;   \
     } while (0)
 
 /**
@@ -41,6 +41,15 @@ typedef struct {
  */
 void DWT_Init();
 
+/**
+ * @brief 获取初始化后经过的CPU周期数,64位单调递增,不会溢出
+ * @attention 无锁、可重入,可在任意中断中调用,读路径上没有除法
+ *            要求两次调用的间隔不超过2^31个周期(约29.8s),TIM4的守护中断可保证这一点
+ *
+ * @return uint64_t 周期数
+ */
+uint64_t DWT_GetCycles64(void);
+
 /**
  * @brief 获取两次调用之间的时间间隔,单位为秒/s
  *
@@ -88,13 +97,71 @@ uint64_t DWT_GetTimeline_us(void);
 void DWT_Delay(float Delay);
 
 /**
- * @brief DWT更新时间轴函数,会被三个timeline函数调用
+ * @brief DWT延时函数,单位为CPU周期,整个等待过程不涉及浮点运算
+ * @attention 同DWT_Delay,可以在临界区和关闭中断时使用
+ *
+ * @param cycles 延时周期数
+ */
+void DWT_Delay_cycles(uint64_t cycles);
+
+/**
+ * @brief DWT更新时间轴函数,会被DWT_GetCycles64及三个timeline函数调用
  * @attention
- * 如果长时间不调用timeline函数,则需要手动调用该函数更新时间轴,否则CYCCNT溢出后定时和时间轴不准确
+ * 如果超过约29.8s不调用上述函数,则需要手动调用该函数更新时间轴,否则CYCCNT溢出后定时和时间轴不准确
  */
 void DWT_SysTimeUpdate(void);
 float DWT_GetDeltaT_Expect(uint32_t* cnt_last, float expect);
 double DWT_GetDeltaT64_Expect(uint32_t* cnt_last, double expect);
 #ifdef __cplusplus
 }
+
+#include <chrono>
+
+namespace bsp::dwt {
+inline constexpr uint32_t cpu_freq_hz = DWT_CPU_FREQ_HZ;
+static_assert(cpu_freq_hz % 1000000 == 0, "CPU频率须为整MHz,否则us/周期换算不精确");
+
+// 时间 -> 周期,对字面量在编译期完成
+[[nodiscard]] constexpr uint64_t s_to_cycles(uint64_t s) noexcept { return s * cpu_freq_hz; }
+[[nodiscard]] constexpr uint64_t ms_to_cycles(uint64_t ms) noexcept {
+    return ms * (cpu_freq_hz / 1000);
+}
+[[nodiscard]] constexpr uint64_t us_to_cycles(uint64_t us) noexcept {
+    return us * (cpu_freq_hz / 1000000);
+}
+
+// 周期 -> 时间,向下取整
+[[nodiscard]] constexpr uint64_t cycles_to_s(uint64_t cycles) noexcept {
+    return cycles / cpu_freq_hz;
+}
+[[nodiscard]] constexpr uint64_t cycles_to_ms(uint64_t cycles) noexcept {
+    return cycles / (cpu_freq_hz / 1000);
+}
+[[nodiscard]] constexpr uint64_t cycles_to_us(uint64_t cycles) noexcept {
+    return cycles / (cpu_freq_hz / 1000000);
+}
+
+// 一次CYCCNT溢出恰好是2^32个周期
+static_assert(cycles_to_us((uint64_t{1} << 32) * 100000) == 5965232355555ULL);
+static_assert(cycles_to_ms(s_to_cycles(86400 * 28)) == 86400ULL * 28 * 1000);
+
+/**
+ * @brief 以DWT周期为tick的std::chrono时钟
+ *        std::chrono字面量(3s, 200ms, 50us)可隐式转换为clock::duration,
+ *        换算为整数乘法且在编译期完成,运行时只有64位整数比较和加减
+ */
+struct clock {
+    using rep                       = uint64_t;
+    using period                    = std::ratio<1, cpu_freq_hz>;
+    using duration                  = std::chrono::duration<rep, period>;
+    using time_point                = std::chrono::time_point<clock>;
+    static constexpr bool is_steady = true;
+
+    [[nodiscard]] static time_point now() noexcept { return time_point(duration(DWT_GetCycles64())); }
+};
+
+inline void delay(clock::duration duration) { DWT_Delay_cycles(duration.count()); }
+
+static_assert(clock::duration(std::chrono::milliseconds(200)).count() == ms_to_cycles(200));
+} // namespace bsp::dwt
 #endif
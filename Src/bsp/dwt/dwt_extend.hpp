@@ -0,0 +1,34 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace bsp::dwt {
+
+/**
+ * @brief 根据32位计数器的最高位推进半周期计数,并返回64位周期数
+ * @tparam HalfCounter 提供load/compare_exchange_strong的半周期计数,目标上为std::atomic<uint32_t>
+ * @tparam ReadCounter 读取32位计数器的函数,目标上读DWT->CYCCNT,主机测试中注入模拟计数器
+ * @attention 假设两次调用之间的时间间隔不超过2^31个周期
+ *
+ * @note 半周期计数的最低位与计数器的最高位同步翻转,64位周期数 = (half >> 1) << 32 | cnt;
+ *       先读半周期计数再读计数器,保证读到的计数不会超前于计数器;
+ *       本次返回值只由局部的half和cnt_now决定,与CAS是否成功无关。
+ *       用strong CAS发布新计数: ARMv7-M上LDREX与STREX之间的任何异常返回都会清除独占监视器,
+ *       weak CAS即使无人修改也可能失败,不发布则存储的计数落后,留给下一次调用的间隔不足半周期;
+ *       strong CAS只在这种虚假失败时重试,真正失败说明打断者已推进到相同或更新的值,直接放弃
+ */
+template <typename HalfCounter, typename ReadCounter>
+inline uint64_t extend_cycles(HalfCounter& half_count, ReadCounter read_counter) {
+    uint32_t half = half_count.load(std::memory_order_relaxed);
+    std::atomic_signal_fence(std::memory_order_acquire);
+    uint32_t cnt_now = read_counter();
+
+    if ((half ^ (cnt_now >> 31)) & 1U) {
+        uint32_t expected = half++;
+        half_count.compare_exchange_strong(expected, half, std::memory_order_relaxed);
+    }
+    return (static_cast<uint64_t>(half >> 1) << 32) | cnt_now;
+}
+
+} // namespace bsp::dwt
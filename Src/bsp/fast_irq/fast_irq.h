@@ -0,0 +1,44 @@
+/**
+ * @file    fast_irq.h
+ * @brief   串口、串口DMA、CAN接收和EXTI中断的寄存器直连快速路径,与HAL路径共用同一套bsp回调和实例表
+ *          只处理常见事件(空闲/半满/满/发送完成/FIFO挂起/EXTI挂起),其余情况返回false交回HAL处理
+ * @note    默认关闭,编译时加-DBSP_FAST_IRQ_ENABLED=1开启;两种路径从中断入口到用户回调的周期数
+ *          可在开启IRQ_TRACE_ENABLED后通过IRQ_Trace_Table的dispatch统计对比
+ */
+#pragma once
+#ifdef __cplusplus
+extern "C" {
+#endif
+#include "stdbool.h"
+#include "stdint.h"
+#include "stm32f1xx_hal.h"
+
+#ifndef BSP_FAST_IRQ_ENABLED
+# define BSP_FAST_IRQ_ENABLED 0
+#endif
+
+#if BSP_FAST_IRQ_ENABLED
+
+/**
+ * @brief USARTx全局中断,仅接管接收环模式的实例
+ * @return 已处理返回true,否则由调用者继续调用HAL_UART_IRQHandler
+ */
+bool BSP_FastIRQ_UART(UART_HandleTypeDef* huart);
+/**
+ * @brief 串口收发DMA通道中断,传输错误及非接收环模式的接收通道交回HAL
+ */
+bool BSP_FastIRQ_UART_DMA(DMA_HandleTypeDef* hdma);
+/**
+ * @brief CAN接收FIFO中断,直接读取FIFO邮箱并取空到接收环
+ */
+bool BSP_FastIRQ_CAN_RX(CAN_HandleTypeDef* hcan, uint32_t fifo);
+/**
+ * @brief EXTI中断,lines为该中断向量覆盖的EXTI线掩码,一次处理所有挂起的线
+ */
+bool BSP_FastIRQ_EXTI(uint16_t lines);
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
@@ -1,18 +1,38 @@
 #include "gpio.hpp"
+#include "bsp/irq_trace/irq_trace.h"
+#include "bsp/sleep/sleep.hpp"
 
 namespace bsp
 {
-    gpio_base *gpio_base::gpio_instances_[MAX_GPIO_INSTANCES] = {nullptr};
-    size_t gpio_base::gpio_instance_count_                    = 0;
+    tool::registry<gpio_base, gpio_base::MAX_GPIO_INSTANCES> gpio_base::gpio_instances_;
+
+    void gpio_base::dispatch_exti(size_t line)
+    {
+        auto instance = gpio_instances_.Find(line);
+        if (instance != nullptr) {
+            IRQ_TRACE_DISPATCH();
+            instance->OnEXTICallback();
+            sleep::Notify();
+        }
+    }
 } // namespace bsp
 
 extern "C" void HAL_GPIO_EXTI_Callback(uint16_t GPIO_Pin)
 {
-    for (size_t i = 0; i < bsp::gpio_base::gpio_instance_count_; ++i) {
-        auto instance = bsp::gpio_base::gpio_instances_[i];
-        if (instance->GetPin() == GPIO_Pin) {
-            instance->OnEXTICallback();
-            break;
-        }
+    bsp::gpio_base::dispatch_exti(bsp::gpio_base::GetLine(GPIO_Pin));
+}
+
+#if BSP_FAST_IRQ_ENABLED
+
+extern "C" bool BSP_FastIRQ_EXTI(uint16_t lines)
+{
+    uint32_t pending = EXTI->PR & lines;
+    EXTI->PR         = pending; // 写1清除
+    while (pending != 0U) {
+        bsp::gpio_base::dispatch_exti(static_cast<size_t>(std::countr_zero(pending)));
+        pending &= pending - 1U;
     }
-}
\ No newline at end of file
+    return true;
+}
+
+#endif
@@ -1,4 +1,9 @@
 #pragma once
+#include "bsp/fast_irq/fast_irq.h"
+#include "tool/registry.hpp"
+
+#include <bit>
+
 #include <gpio.h>
 
 namespace bsp {
@@ -13,9 +18,13 @@ enum class GPIO_EXTI_MODE : uint8_t {
 // 非模板基类
 class gpio_base {
 public:
-    virtual ~gpio_base() { unregister_instance(this); }
+    virtual ~gpio_base() { gpio_instances_.Unregister(this); }
     virtual void OnEXTICallback() = 0;
     [[nodiscard]] uint16_t GetPin() const { return GPIO_Pin_; }
+    // 引脚号即EXTI线号,作为实例表的键;不同端口的同号引脚共用一条EXTI线,只有先注册者能收到回调
+    [[nodiscard]] static size_t GetLine(uint16_t GPIO_Pin) {
+        return static_cast<size_t>(std::countr_zero(GPIO_Pin));
+    }
 
 protected:
     GPIO_TypeDef* GPIOx_;
@@ -29,33 +38,21 @@ protected:
         , pin_state_(pin_state)
         , exti_mode_(exti_mode)
         , GPIO_Pin_(GPIO_Pin) {
-        register_instance(this);
-    }
-    static void unregister_instance(gpio_base* instance) {
-        for (size_t i = 0; i < gpio_instance_count_; ++i) {
-            if (gpio_instances_[i] == instance) {
-                for (size_t j = i; j < gpio_instance_count_ - 1; ++j) {
-                    gpio_instances_[j] = gpio_instances_[j + 1];
-                }
-                --gpio_instance_count_;
-                break;
-            }
-        }
-    }
-    static void register_instance(gpio_base* instance) {
-        if (gpio_instance_count_ < MAX_GPIO_INSTANCES) {
-            gpio_instances_[gpio_instance_count_++] = instance;
-        }
-        // 可以添加错误处理
+        gpio_instances_.Register(GetLine(GPIO_Pin), this);
     }
 
 private:
-    // 静态数组保存所有实例
+    // 按EXTI线号保存所有实例
     static constexpr size_t MAX_GPIO_INSTANCES = 16;
-    static gpio_base* gpio_instances_[MAX_GPIO_INSTANCES];
-    static size_t gpio_instance_count_;
+    static tool::registry<gpio_base, MAX_GPIO_INSTANCES> gpio_instances_;
+
+    // HAL和快速中断路径共用的EXTI分发
+    static void dispatch_exti(size_t line);
 
     friend void ::HAL_GPIO_EXTI_Callback(uint16_t GPIO_Pin);
+#if BSP_FAST_IRQ_ENABLED
+    friend bool ::BSP_FastIRQ_EXTI(uint16_t lines);
+#endif
 };
 
 // 模板类
@@ -0,0 +1,18 @@
+#include "irq_trace.h"
+
+#if IRQ_TRACE_ENABLED
+
+# include "tool/critical_section.hpp"
+
+# include <cstring>
+
+IRQ_Trace_Entry IRQ_Trace_Table[IRQ_TRACE_COUNT] = {};
+uint8_t IRQ_Trace_Depth                          = 0;
+IRQ_Trace_Frame IRQ_Trace_Current                = {IRQ_TRACE_COUNT, 0};
+
+void IRQ_Trace_Reset(void) {
+    tool::critical_section cs;
+    std::memset(IRQ_Trace_Table, 0, sizeof(IRQ_Trace_Table));
+}
+
+#endif
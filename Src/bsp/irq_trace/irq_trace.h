@@ -0,0 +1,112 @@
+/**
+ * @file    irq_trace.h
+ * @brief   中断耗时统计,在stm32f1xx_it.c的各中断入口/出口用DWT打时间戳
+ *          记录每个中断的次数、最长/累计耗时(包含被更高优先级中断抢占的时间)以及进入时的最大嵌套深度,
+ *          bsp层在调用用户回调前用IRQ_TRACE_DISPATCH()记录从中断入口到回调的周期数
+ * @note    默认关闭,编译时加-DIRQ_TRACE_ENABLED=1开启,每个中断约增加20个周期
+ */
+#pragma once
+#ifdef __cplusplus
+extern "C" {
+#endif
+#include "stdint.h"
+#include "stm32f1xx.h"
+
+#ifndef IRQ_TRACE_ENABLED
+# define IRQ_TRACE_ENABLED 0
+#endif
+
+typedef enum {
+    IRQ_TRACE_DMA1_CH2,
+    IRQ_TRACE_DMA1_CH3,
+    IRQ_TRACE_DMA1_CH4,
+    IRQ_TRACE_DMA1_CH5,
+    IRQ_TRACE_DMA1_CH6,
+    IRQ_TRACE_DMA1_CH7,
+    IRQ_TRACE_CAN1_TX,
+    IRQ_TRACE_CAN1_RX0,
+    IRQ_TRACE_CAN1_RX1,
+    IRQ_TRACE_CAN1_SCE,
+    IRQ_TRACE_EXTI9_5,
+    IRQ_TRACE_EXTI15_10,
+    IRQ_TRACE_TIM4,
+    IRQ_TRACE_USART1,
+    IRQ_TRACE_USART2,
+    IRQ_TRACE_USART3,
+    IRQ_TRACE_COUNT,
+} IRQ_Trace_Id;
+
+typedef struct {
+    uint32_t count;
+    uint32_t max_cycles;
+    uint64_t total_cycles; // 平均耗时 = total_cycles / count
+    uint8_t max_depth;     // 进入时已在执行的中断层数的最大值,0表示从未打断其他中断
+    uint32_t dispatch_count;
+    uint32_t max_dispatch_cycles;
+    uint64_t total_dispatch_cycles; // 中断入口到用户回调的平均周期数 = total / dispatch_count
+} IRQ_Trace_Entry;
+
+// 当前正在执行的中断及其入口时间,嵌套时由IRQ_Trace_Exit恢复为被打断者
+typedef struct {
+    IRQ_Trace_Id id;
+    uint32_t start;
+} IRQ_Trace_Frame;
+
+#if IRQ_TRACE_ENABLED
+
+extern IRQ_Trace_Entry IRQ_Trace_Table[IRQ_TRACE_COUNT];
+extern uint8_t IRQ_Trace_Depth; // 嵌套的中断总是先于被打断者返回,进出成对,无需volatile
+extern IRQ_Trace_Frame IRQ_Trace_Current;
+
+static inline IRQ_Trace_Frame IRQ_Trace_Enter(IRQ_Trace_Id id) {
+    IRQ_Trace_Frame outer = IRQ_Trace_Current;
+    uint32_t start        = DWT->CYCCNT;
+    uint8_t depth         = IRQ_Trace_Depth;
+    IRQ_Trace_Depth       = depth + 1;
+    if (depth > IRQ_Trace_Table[id].max_depth)
+        IRQ_Trace_Table[id].max_depth = depth;
+    IRQ_Trace_Current.id    = id;
+    IRQ_Trace_Current.start = start;
+    return outer;
+}
+
+static inline void IRQ_Trace_Exit(IRQ_Trace_Id id, IRQ_Trace_Frame outer) {
+    uint32_t cycles        = DWT->CYCCNT - IRQ_Trace_Current.start;
+    IRQ_Trace_Entry* entry = &IRQ_Trace_Table[id];
+    entry->count++;
+    entry->total_cycles += cycles;
+    if (cycles > entry->max_cycles)
+        entry->max_cycles = cycles;
+    IRQ_Trace_Depth   = IRQ_Trace_Depth - 1;
+    IRQ_Trace_Current = outer;
+}
+
+// 在被IRQ_TRACE_ENTER/EXIT包围的中断中调用,其他上下文中调用不计入
+static inline void IRQ_Trace_Dispatch(void) {
+    if (IRQ_Trace_Current.id == IRQ_TRACE_COUNT)
+        return;
+    uint32_t cycles        = DWT->CYCCNT - IRQ_Trace_Current.start;
+    IRQ_Trace_Entry* entry = &IRQ_Trace_Table[IRQ_Trace_Current.id];
+    entry->dispatch_count++;
+    entry->total_dispatch_cycles += cycles;
+    if (cycles > entry->max_dispatch_cycles)
+        entry->max_dispatch_cycles = cycles;
+}
+
+/**
+ * @brief 清空统计,在任务中调用
+ */
+void IRQ_Trace_Reset(void);
+
+# define IRQ_TRACE_ENTER(id)   IRQ_Trace_Frame irq_trace_outer_ = IRQ_Trace_Enter(id)
+# define IRQ_TRACE_EXIT(id)    IRQ_Trace_Exit(id, irq_trace_outer_)
+# define IRQ_TRACE_DISPATCH() IRQ_Trace_Dispatch()
+#else
+# define IRQ_TRACE_ENTER(id)
+# define IRQ_TRACE_EXIT(id)
+# define IRQ_TRACE_DISPATCH()
+#endif
+
+#ifdef __cplusplus
+}
+#endif
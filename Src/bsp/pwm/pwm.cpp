@@ -3,18 +3,17 @@
 namespace bsp {
 
 // 静态成员变量初始化
-pwm_base* pwm_base::pwm_instances_[pwm_base::MAX_PWM_INSTANCES] = {nullptr};
-size_t pwm_base::pwm_instance_count_                            = 0;
+tool::registry<pwm_base, pwm_base::MAX_PWM_INSTANCES> pwm_base::pwm_instances_;
 
 } // namespace bsp
 
 extern "C" void HAL_TIM_PWM_PulseFinishedCallback(TIM_HandleTypeDef* htim) {
     using namespace bsp;
-    for (size_t i = 0; i < pwm_base::pwm_instance_count_; ++i) {
-        auto instance = pwm_base::pwm_instances_[i];
-        if (instance->GetHandle() == htim) {
-            instance->OnPulseFinishedCallback();
-            break;
-        }
+    // htim->Channel为HAL_TIM_ACTIVE_CHANNEL_x,按位表示通道
+    auto channel  = static_cast<uint32_t>(htim->Channel);
+    auto instance = pwm_base::pwm_instances_.Find(
+        pwm_base::instance_key(htim->Instance, std::countr_zero(channel)));
+    if (instance != nullptr) {
+        instance->OnPulseFinishedCallback();
     }
 }
\ No newline at end of file
@@ -1,4 +1,8 @@
 #pragma once
+#include "tool/registry.hpp"
+
+#include <bit>
+#include <chrono>
 #include <cstdint>
 
 #include <tim.h>
@@ -6,11 +10,20 @@
 
 namespace bsp {
 
+// 占空比使用Q16定点数表示, 0 ~ 65536 对应 0.0 ~ 1.0
+using duty_q16_t                      = uint32_t;
+inline constexpr duty_q16_t duty_full = 1U << 16;
+
+// 仅在编译期将小数占空比转为定点数,例如 duty_cycle(0.25)
+consteval duty_q16_t duty_cycle(double ratio) {
+    return static_cast<duty_q16_t>(ratio * duty_full + 0.5);
+}
+
 // 非模板基类
 class pwm_base {
 public:
     virtual ~pwm_base() {
-        unregister_instance(this);
+        pwm_instances_.Unregister(this);
         Stop();
     }
     void Begin() {
@@ -28,33 +41,37 @@ public:
 protected:
     TIM_HandleTypeDef* htim_;
     uint32_t channel_;
-    float period_;
-    float duty_cycle_;
+    std::chrono::nanoseconds period_;
+    duty_q16_t duty_cycle_;
     uint32_t tclk_;                      // 时钟频率
 
-    pwm_base(TIM_HandleTypeDef* htim, uint32_t channel, float period, float duty_cycle)
+    pwm_base(
+        TIM_HandleTypeDef* htim, uint32_t channel, std::chrono::nanoseconds period,
+        duty_q16_t duty_cycle)
         : htim_(htim)
         , channel_(channel)
         , period_(period)
         , duty_cycle_(duty_cycle) {
-        register_instance(this);
+        pwm_instances_.Register(instance_key(htim->Instance, channel / TIM_CHANNEL_2), this);
     }
 
     void Start() { HAL_TIM_PWM_Start(htim_, channel_); }
 
     void Stop() { HAL_TIM_PWM_Stop(htim_, channel_); }
 
-    void SetPeriod(float period) {
+    void SetPeriod(std::chrono::nanoseconds period) {
         period_  = period;
         auto arr = static_cast<uint16_t>(
-            period_ * static_cast<float>(tclk_) / (htim_->Init.Prescaler + 1.0));
+            static_cast<uint64_t>(period_.count()) * tclk_
+            / (1'000'000'000ULL * (htim_->Init.Prescaler + 1)));
         __HAL_TIM_SET_AUTORELOAD(htim_, arr);
         __HAL_TIM_SET_COUNTER(htim_, 0); // 改变周期后重置计数器
     }
 
-    void SetDutyCycle(float duty_cycle) {
+    void SetDutyCycle(duty_q16_t duty_cycle) {
         duty_cycle_  = duty_cycle;
-        auto compare = static_cast<uint16_t>(duty_cycle_ * (__HAL_TIM_GET_AUTORELOAD(htim_) + 1.0));
+        auto compare = static_cast<uint16_t>(
+            (static_cast<uint64_t>(__HAL_TIM_GET_AUTORELOAD(htim_)) + 1) * duty_cycle_ >> 16);
         __HAL_TIM_SET_COMPARE(htim_, channel_, compare);
     }
 
@@ -74,28 +91,25 @@ protected:
         return tim_clk;
     }
 
-    static void register_instance(pwm_base* instance) {
-        if (pwm_instance_count_ < MAX_PWM_INSTANCES) {
-            pwm_instances_[pwm_instance_count_++] = instance;
-        }
-    }
-
-    static void unregister_instance(pwm_base* instance) {
-        for (size_t i = 0; i < pwm_instance_count_; ++i) {
-            if (pwm_instances_[i] == instance) {
-                for (size_t j = i; j < pwm_instance_count_ - 1; ++j) {
-                    pwm_instances_[j] = pwm_instances_[j + 1];
-                }
-                --pwm_instance_count_;
-                break;
-            }
+    // TIM1~TIM4依次对应0~3,每个定时器4个通道,键为 定时器序号 * 4 + 通道序号
+    static size_t instance_key(const TIM_TypeDef* tim, size_t channel_index) {
+        size_t timer = MAX_PWM_INSTANCES / CHANNELS_PER_TIMER;
+        if (tim == TIM1) {
+            timer = 0;
+        } else if (tim == TIM2) {
+            timer = 1;
+        } else if (tim == TIM3) {
+            timer = 2;
+        } else if (tim == TIM4) {
+            timer = 3;
         }
+        return timer * CHANNELS_PER_TIMER + channel_index;
     }
 
 private:
-    static constexpr size_t MAX_PWM_INSTANCES = 16;
-    static pwm_base* pwm_instances_[MAX_PWM_INSTANCES];
-    static size_t pwm_instance_count_;
+    static constexpr size_t CHANNELS_PER_TIMER = 4;
+    static constexpr size_t MAX_PWM_INSTANCES  = 16;
+    static tool::registry<pwm_base, MAX_PWM_INSTANCES> pwm_instances_;
 
     friend void ::HAL_TIM_PWM_PulseFinishedCallback(TIM_HandleTypeDef* htim);
 };
@@ -107,12 +121,12 @@ public:
     using CallbackFunction = void (Derived::*)();
 
     struct pwm_params {
-        TIM_HandleTypeDef* htim    = nullptr;       // TIM句柄
-        uint32_t channel           = TIM_CHANNEL_1; // 通道
-        float period               = 0.0f;          // 周期（秒）
-        float duty_cycle           = 0.0f;          // 占空比（0.0 - 1.0）
-        Derived* callback_instance = nullptr;       // 回调实例
-        CallbackFunction callback  = nullptr;       // 回调函数
+        TIM_HandleTypeDef* htim         = nullptr;       // TIM句柄
+        uint32_t channel                = TIM_CHANNEL_1; // 通道
+        std::chrono::nanoseconds period = {};            // 周期
+        duty_q16_t duty_cycle           = 0;             // 占空比（Q16，见duty_cycle()）
+        Derived* callback_instance      = nullptr;       // 回调实例
+        CallbackFunction callback       = nullptr;       // 回调函数
     };
 
     explicit pwm(const pwm_params& params)
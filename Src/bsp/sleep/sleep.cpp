@@ -0,0 +1,62 @@
+#include "sleep.hpp"
+#include "bsp/dwt/dwt.h"
+#include "tool/critical_section.hpp"
+
+#include <stm32f1xx_hal.h>
+
+namespace bsp {
+
+namespace {
+// HAL时基为默认的1kHz
+constexpr uint32_t CYCLES_PER_HAL_TICK = dwt::cpu_freq_hz / 1000U;
+} // namespace
+
+volatile bool sleep::pending_   = false;
+uint64_t sleep::idle_cycles_    = 0;
+uint64_t sleep::window_start_   = 0;
+uint64_t sleep::window_idle_    = 0;
+uint64_t sleep::tick_remainder_ = 0;
+
+void sleep::Begin() {
+#ifndef NDEBUG
+    // 调试时保持睡眠下的内核时钟,否则WFI期间调试器会断开
+    DBGMCU->CR = DBGMCU->CR | DBGMCU_CR_DBG_SLEEP;
+#endif
+    SCB->SCR = SCB->SCR & ~SCB_SCR_SLEEPDEEP_Msk;
+    window_start_ = DWT_GetCycles64();
+}
+
+void sleep::WaitForEvent() {
+    __disable_irq();
+    while (!pending_) {
+        uint64_t start = DWT_GetCycles64();
+        HAL_SuspendTick();
+        __DSB();
+        __WFI();
+        HAL_ResumeTick();
+        uint64_t slept = DWT_GetCycles64() - start;
+        idle_cycles_ += slept;
+        // 补上睡眠期间少计的HAL时基,余数留到下次
+        tick_remainder_ += slept;
+        uwTick = uwTick + static_cast<uint32_t>(tick_remainder_ / CYCLES_PER_HAL_TICK);
+        tick_remainder_ %= CYCLES_PER_HAL_TICK;
+        // 开中断让唤醒源的中断执行,再回到检查
+        __enable_irq();
+        __ISB();
+        __disable_irq();
+    }
+    pending_ = false;
+    __enable_irq();
+}
+
+uint32_t sleep::GetIdlePercent() {
+    tool::critical_section cs;
+    uint64_t now   = DWT_GetCycles64();
+    uint64_t total = now - window_start_;
+    uint64_t idle  = idle_cycles_ - window_idle_;
+    window_start_  = now;
+    window_idle_   = idle_cycles_;
+    return total == 0 ? 0 : static_cast<uint32_t>(idle * 100 / total);
+}
+
+} // namespace bsp
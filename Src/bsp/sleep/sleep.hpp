@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+
+namespace bsp {
+
+/**
+ * 主循环空闲睡眠
+ * 中断回调在产生需要主循环处理的事件时调用Notify(),主循环每轮结束时调用WaitForEvent(),
+ * 没有待处理事件时内核进入WFI睡眠,任意中断(EXTI/UART/DMA/CAN/TIM4)均可唤醒;
+ * 睡眠期间暂停SysTick中断,醒来后按DWT计得的睡眠时间补上HAL时基(uwTick),
+ * 空闲时的唤醒只剩守护调度每约60ms一次的保活比较
+ */
+class sleep {
+public:
+    static void Begin();
+
+    // 在中断中调用,标记主循环有事件待处理
+    static void Notify() { pending_ = true; }
+
+    /**
+     * 没有事件时睡眠直到有事件到来
+     * 事件检查与WFI在关中断下进行,被挂起的中断仍能唤醒WFI,因此不会丢失唤醒;
+     * 只唤醒了而没有Notify的中断(如TIM4保活比较)执行完后会继续睡眠
+     */
+    static void WaitForEvent();
+
+    // 自上次调用以来处于睡眠的时间百分比
+    [[nodiscard]] static uint32_t GetIdlePercent();
+    [[nodiscard]] static uint64_t GetIdleCycles() { return idle_cycles_; }
+
+private:
+    static volatile bool pending_;
+    static uint64_t idle_cycles_;
+    static uint64_t window_start_;
+    static uint64_t window_idle_;
+    static uint64_t tick_remainder_; // 睡眠中不足一个HAL时基的周期数
+};
+
+} // namespace bsp
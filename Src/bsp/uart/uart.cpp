@@ -1,31 +1,163 @@
 #include "uart.hpp"
+#include "bsp/irq_trace/irq_trace.h"
+#include "bsp/sleep/sleep.hpp"
 
 namespace bsp {
 // 静态成员变量初始化
-uart_base* uart_base::uart_instances_[uart_base::MAX_UART_INSTANCES] = {nullptr};
-size_t uart_base::uart_instance_count_                               = 0;
+tool::registry<uart_base, uart_base::MAX_UART_INSTANCES> uart_base::uart_instances_;
+
+void uart_base::dispatch_rx_event(uint16_t size) {
+    if (rx_mode_ == UART_RX_MODE::RING) {
+        publish_ring(size);
+    } else {
+        SetTrueRxSize(size);
+        stats_.rx_bytes += size;
+    }
+    IRQ_TRACE_DISPATCH();
+    OnRxCpltCallback();
+    // ReceiveDMAAuto();
+    sleep::Notify();
+}
+
+void uart_base::dispatch_error(uint32_t error_code) {
+    if ((error_code & HAL_UART_ERROR_PE) != 0U) {
+        ++stats_.parity_errors;
+    }
+    if ((error_code & HAL_UART_ERROR_FE) != 0U) {
+        ++stats_.framing_errors;
+    }
+    if ((error_code & HAL_UART_ERROR_NE) != 0U) {
+        ++stats_.noise_errors;
+    }
+    if ((error_code & HAL_UART_ERROR_ORE) != 0U) {
+        ++stats_.overrun_errors;
+    }
+    if ((error_code & HAL_UART_ERROR_DMA) != 0U) {
+        ++stats_.dma_errors;
+    }
+    count_error();
+    if (recovery_pending_) {
+        // 唤醒使用者,恢复在主循环下一次调用Available()时执行
+        OnRxCpltCallback();
+        sleep::Notify();
+    }
+}
 } // namespace bsp
 
 extern "C" void HAL_UARTEx_RxEventCallback(UART_HandleTypeDef* huart, uint16_t Size) {
     using namespace bsp;
-    for (size_t i = 0; i < uart_base::uart_instance_count_; ++i) {
-        auto instance = uart_base::uart_instances_[i];
-        if (instance->GetHandle() == huart) {
-            instance->SetTrueRxSize(Size);
-            instance->OnRxCpltCallback();
-            // instance->ReceiveDMAAuto();
-            break;
-        }
+    auto instance = uart_base::uart_instances_.Find(uart_base::instance_key(huart->Instance));
+    if (instance != nullptr) {
+        instance->dispatch_rx_event(Size);
     }
 }
 
 extern "C" void HAL_UART_ErrorCallback(UART_HandleTypeDef* huart) {
     using namespace bsp;
-    for (size_t i = 0; i < uart_base::uart_instance_count_; ++i) {
-        auto instance = uart_base::uart_instances_[i];
-        if (instance->GetHandle() == huart) {
-            instance->ReceiveDMAAuto();
-            break;
+    auto instance = uart_base::uart_instances_.Find(uart_base::instance_key(huart->Instance));
+    if (instance == nullptr) {
+        return;
+    }
+    instance->dispatch_error(huart->ErrorCode);
+    if (instance->rx_mode_ == UART_RX_MODE::RING) {
+        instance->restart_ring();
+    } else {
+        instance->ReceiveDMAAuto();
+    }
+    // 发送DMA出错时HAL已结束本次发送,重发队头帧
+    if (instance->tx_busy_ && huart->gState == HAL_UART_STATE_READY) {
+        instance->start_next_tx();
+    }
+}
+
+extern "C" void HAL_UART_TxCpltCallback(UART_HandleTypeDef* huart) {
+    using namespace bsp;
+    auto instance = uart_base::uart_instances_.Find(uart_base::instance_key(huart->Instance));
+    if (instance != nullptr) {
+        instance->dispatch_tx_complete();
+    }
+}
+
+#if BSP_FAST_IRQ_ENABLED
+
+extern "C" bool BSP_FastIRQ_UART(UART_HandleTypeDef* huart) {
+    using namespace bsp;
+    auto instance = uart_base::uart_instances_.Find(uart_base::instance_key(huart->Instance));
+    if (instance == nullptr || instance->rx_mode_ != UART_RX_MODE::RING) {
+        return false;
+    }
+    USART_TypeDef* usart = huart->Instance;
+    uint32_t sr          = usart->SR;
+    uint32_t cr1         = usart->CR1;
+    if ((sr & (USART_SR_PE | USART_SR_FE | USART_SR_NE | USART_SR_ORE | USART_SR_IDLE)) != 0U) {
+        // 先读SR再读DR清除错误和空闲标志;循环DMA继续运行,出错的字节由使用者按帧校验丢弃
+        static_cast<void>(usart->DR);
+    }
+    // 状态寄存器中FE/NE的位序与HAL_UART_ERROR_FE/NE相反,逐位转换
+    uint32_t errors = 0U;
+    errors |= (sr & USART_SR_PE) != 0U ? HAL_UART_ERROR_PE : 0U;
+    errors |= (sr & USART_SR_FE) != 0U ? HAL_UART_ERROR_FE : 0U;
+    errors |= (sr & USART_SR_NE) != 0U ? HAL_UART_ERROR_NE : 0U;
+    errors |= (sr & USART_SR_ORE) != 0U ? HAL_UART_ERROR_ORE : 0U;
+    if (errors != 0U) {
+        instance->dispatch_error(errors);
+    }
+    if ((sr & USART_SR_IDLE) != 0U && (cr1 & USART_CR1_IDLEIE) != 0U) {
+        auto remaining = static_cast<uint16_t>(__HAL_DMA_GET_COUNTER(huart->hdmarx));
+        if (remaining > 0U && remaining < huart->RxXferSize) {
+            instance->dispatch_rx_event(huart->RxXferSize - remaining);
+        }
+    }
+    if ((sr & USART_SR_TC) != 0U && (cr1 & USART_CR1_TCIE) != 0U) {
+        ATOMIC_CLEAR_BIT(usart->CR1, USART_CR1_TCIE);
+        huart->gState = HAL_UART_STATE_READY;
+        instance->dispatch_tx_complete();
+    }
+    return true;
+}
+
+extern "C" bool BSP_FastIRQ_UART_DMA(DMA_HandleTypeDef* hdma) {
+    using namespace bsp;
+    auto huart    = static_cast<UART_HandleTypeDef*>(hdma->Parent);
+    auto instance = uart_base::uart_instances_.Find(uart_base::instance_key(huart->Instance));
+    uint32_t flags = hdma->DmaBaseAddress->ISR >> hdma->ChannelIndex;
+    uint32_t ccr   = hdma->Instance->CCR;
+    if (instance == nullptr || (flags & DMA_ISR_TEIF1) != 0U) {
+        return false;
+    }
+    bool half     = (flags & DMA_ISR_HTIF1) != 0U && (ccr & DMA_CCR_HTIE) != 0U;
+    bool complete = (flags & DMA_ISR_TCIF1) != 0U && (ccr & DMA_CCR_TCIE) != 0U;
+
+    if (hdma == huart->hdmarx) {
+        if (instance->rx_mode_ != UART_RX_MODE::RING) {
+            return false;
+        }
+        // 循环模式下半满和满事件分别对应写入位置RxXferSize/2和RxXferSize
+        hdma->DmaBaseAddress->IFCR = (DMA_IFCR_CHTIF1 | DMA_IFCR_CTCIF1) << hdma->ChannelIndex;
+        if (half) {
+            instance->dispatch_rx_event(huart->RxXferSize / 2U);
+        }
+        if (complete) {
+            instance->dispatch_rx_event(huart->RxXferSize);
         }
+        return true;
     }
-}
\ No newline at end of file
+
+    // 发送为普通模式: 与HAL相同,半满事件只清除并关闭,发送完成后转由USART的TC中断结束本帧
+    if (half) {
+        hdma->Instance->CCR        = ccr & ~DMA_CCR_HTIE;
+        hdma->DmaBaseAddress->IFCR = DMA_IFCR_CHTIF1 << hdma->ChannelIndex;
+    }
+    if (complete) {
+        hdma->Instance->CCR        = ccr & ~(DMA_CCR_HTIE | DMA_CCR_TCIE | DMA_CCR_TEIE);
+        hdma->DmaBaseAddress->IFCR = DMA_IFCR_CTCIF1 << hdma->ChannelIndex;
+        hdma->State                = HAL_DMA_STATE_READY;
+        __HAL_UNLOCK(hdma);
+        huart->TxXferCount = 0U;
+        ATOMIC_CLEAR_BIT(huart->Instance->CR3, USART_CR3_DMAT);
+        ATOMIC_SET_BIT(huart->Instance->CR1, USART_CR1_TCIE);
+    }
+    return true;
+}
+
+#endif
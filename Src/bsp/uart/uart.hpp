@@ -1,6 +1,13 @@
 #pragma once
 
+#include "bsp/fast_irq/fast_irq.h"
+#include "tool/critical_section.hpp"
+#include "tool/frame_view.hpp"
+#include "tool/registry.hpp"
+
+#include <atomic>
 #include <cstdint>
+#include <cstring>
 
 #include <usart.h>
 
@@ -12,10 +19,42 @@ enum class UART_TRANSFER_MODE : uint8_t {
     DMA,
 };
 
+enum class UART_RX_MODE : uint8_t {
+    ONESHOT = 0, // 空闲中断后DMA停止,由使用者调用ReceiveDMAAuto重新启动
+    RING,        // 接收DMA需配置为循环模式,持续写入接收环,使用者通过Available/Read取数据
+};
+
+enum class UART_TX_RESULT : uint8_t {
+    OK = 0,
+    QUEUE_FULL, // 发送队列已满,帧未入队
+    TOO_LONG,   // 帧长超过发送缓冲区
+};
+
+// 链路健康统计,错误类别对应USART状态寄存器的PE/FE/NE/ORE
+struct uart_link_stats {
+    uint32_t parity_errors;
+    uint32_t framing_errors;
+    uint32_t noise_errors;
+    uint32_t overrun_errors;    // 外设接收溢出,DMA未及时取走数据
+    uint32_t dma_errors;
+    uint32_t rx_bytes;
+    uint32_t rx_frames;         // 使用者上报的完整帧,含校验失败的帧
+    uint32_t checksum_failures;
+    uint32_t rx_ring_overruns;  // 接收环被DMA套圈,未读数据整体丢弃
+    uint32_t tx_dropped;        // 发送队列满而丢弃的帧
+    uint32_t recoveries;        // 自动恢复(清空、重新同步并重新初始化外设)的次数
+};
+
+// 链路速率策略: safe为模块出厂速率,target为启动时协商的目标速率,两者相同则不协商
+struct uart_baud_policy {
+    uint32_t safe   = 115200;
+    uint32_t target = 115200;
+};
+
 // 非模板基类
 class uart_base {
 public:
-    virtual ~uart_base() { unregister_instance(this); }
+    virtual ~uart_base() { uart_instances_.Unregister(this); }
 
     virtual void OnRxCpltCallback() = 0;
     [[nodiscard]] UART_HandleTypeDef* GetHandle() const { return uart_handle_; }
@@ -27,9 +66,15 @@ public:
         } else {
             HAL_UARTEx_ReceiveToIdle_DMA(uart_handle_, rx_buffer_, rx_size_);
         }
-        __HAL_DMA_DISABLE_IT(uart_handle_->hdmarx, DMA_IT_HT);
+        uart_handle_->hdmarx->Instance->CCR = uart_handle_->hdmarx->Instance->CCR & ~DMA_IT_HT;
+    }
+    void Begin() {
+        if (rx_mode_ == UART_RX_MODE::RING) {
+            start_ring();
+        } else {
+            ReceiveDMAAuto();
+        }
     }
-    void Begin() { ReceiveDMAAuto(); }
     uint8_t* GetRxBuffer() { return rx_buffer_; }
     [[nodiscard]] bool IsReady() const { return (uart_handle_->gState != HAL_UART_STATE_BUSY_TX); }
 
@@ -50,45 +95,249 @@ public:
     }
     void set_dma_rx_buffer(uint8_t* buffer) { rx_buffer_user = buffer; }
 
+    /**
+     * @brief 按新波特率重新初始化外设并重启接收,接收环中未读的数据被丢弃
+     * @note 只能在主循环中调用;发送队列未空时返回false,由调用者等待发送完成后重试
+     */
+    bool SetBaudRate(uint32_t baud_rate) {
+        tool::critical_section cs;
+        if (tx_count_ != 0 || uart_handle_->gState != HAL_UART_STATE_READY) {
+            return false;
+        }
+        HAL_UART_AbortReceive(uart_handle_);
+        uart_handle_->Init.BaudRate = baud_rate;
+        bool ok                     = HAL_UART_Init(uart_handle_) == HAL_OK;
+        if (rx_mode_ == UART_RX_MODE::RING) {
+            restart_ring();
+            rx_read_ = rx_written_.load(std::memory_order_relaxed);
+        } else {
+            ReceiveDMAAuto();
+        }
+        return ok;
+    }
+    [[nodiscard]] uint32_t GetBaudRate() const { return uart_handle_->Init.BaudRate; }
+
+    /**
+     * @brief 将帧复制到实例自有的发送缓冲区并排队,空闲时立即启动DMA,否则在上一帧发送完成后接续
+     * @note 非阻塞,可在中断中调用
+     */
+    UART_TX_RESULT Submit(const uint8_t* data, uint16_t size) {
+        if (size > TX_FRAME_SIZE) {
+            return UART_TX_RESULT::TOO_LONG;
+        }
+        tool::critical_section cs;
+        if (tx_count_ == TX_QUEUE_DEPTH) {
+            ++stats_.tx_dropped;
+            return UART_TX_RESULT::QUEUE_FULL;
+        }
+        uint8_t slot = (tx_head_ + tx_count_) % TX_QUEUE_DEPTH;
+        std::memcpy(tx_pool_[slot], data, size);
+        tx_length_[slot] = size;
+        tx_count_ = tx_count_ + 1;
+        if (!tx_busy_) {
+            start_next_tx();
+        }
+        return UART_TX_RESULT::OK;
+    }
+    [[nodiscard]] uint8_t GetTxPending() const { return tx_count_; }
+    [[nodiscard]] uint32_t GetTxDroppedCount() const { return stats_.tx_dropped; }
+
+    // 以下为RING模式下的读取接口,只能在单一上下文(主循环)中调用
+    // 中断中登记了恢复请求时先执行恢复,本次返回0
+    [[nodiscard]] size_t Available() {
+        if (recovery_pending_ && Recover()) {
+            return 0;
+        }
+        uint32_t written = rx_written_.load(std::memory_order_acquire);
+        uint32_t count   = written - rx_read_;
+        if (count > RX_RING_SIZE) {
+            // DMA已套圈,未读数据被覆盖,整体丢弃
+            rx_read_ = written;
+            ++stats_.rx_ring_overruns;
+            return 0;
+        }
+        return count;
+    }
+    [[nodiscard]] uint8_t Peek(size_t offset) const {
+        return rx_buffer_[(rx_read_ + offset) & (RX_RING_SIZE - 1)];
+    }
+    // 从读指针处开始的帧视图,不移动读指针;size不应超过Available(),处理完后调用Skip(size)
+    [[nodiscard]] tool::frame_view View(size_t size) const {
+        return {rx_buffer_, RX_RING_SIZE, rx_read_, size};
+    }
+    size_t Read(uint8_t* buffer, size_t count) {
+        size_t available = Available();
+        count            = count < available ? count : available;
+        size_t index     = rx_read_ & (RX_RING_SIZE - 1);
+        size_t first     = count < RX_RING_SIZE - index ? count : RX_RING_SIZE - index;
+        std::memcpy(buffer, &rx_buffer_[index], first);
+        std::memcpy(buffer + first, &rx_buffer_[0], count - first);
+        rx_read_ += count;
+        return count;
+    }
+    size_t Skip(size_t count) {
+        size_t available = Available();
+        count            = count < available ? count : available;
+        rx_read_ += count;
+        return count;
+    }
+    void Flush() { Skip(RX_RING_SIZE); }
+    [[nodiscard]] uint32_t GetRxOverrunCount() const { return stats_.rx_ring_overruns; }
+
+    /**
+     * @brief 使用者每解析出一帧调用一次,校验失败计入连续错误,连续错误达到阈值时登记恢复
+     */
+    void ReportFrame(bool valid) {
+        tool::critical_section cs;
+        ++stats_.rx_frames;
+        if (valid) {
+            consecutive_errors_ = 0;
+        } else {
+            ++stats_.checksum_failures;
+            count_error();
+        }
+    }
+    /**
+     * @brief 清空接收数据、重新同步并以当前波特率重新初始化外设
+     * @note 只能在主循环中调用;发送未完成时返回false,恢复请求保留到下次
+     */
+    bool Recover() {
+        if (!SetBaudRate(GetBaudRate())) {
+            return false;
+        }
+        tool::critical_section cs;
+        recovery_pending_   = false;
+        consecutive_errors_ = 0;
+        ++stats_.recoveries;
+        return true;
+    }
+    // 统计快照,可在任意上下文中调用
+    [[nodiscard]] uart_link_stats GetStats() const {
+        tool::critical_section cs;
+        return stats_;
+    }
+    void ResetStats() {
+        tool::critical_section cs;
+        stats_ = {};
+    }
+
 protected:
     UART_HandleTypeDef* uart_handle_;
     static constexpr size_t MAX_RX_BUFFER_SIZE = 256;
+    static constexpr size_t RX_RING_SIZE       = MAX_RX_BUFFER_SIZE;
+    static_assert((RX_RING_SIZE & (RX_RING_SIZE - 1)) == 0, "接收环长度需为2的幂");
     uint8_t rx_buffer_[MAX_RX_BUFFER_SIZE];
     uint8_t* rx_buffer_user = nullptr;
     uint16_t rx_size_;
     uint16_t rx_size_from_register_ = 0;
 
-    uart_base(UART_HandleTypeDef* handle, uint16_t rx_size)
+    UART_RX_MODE rx_mode_;
+    // 写计数由接收事件中断发布,读计数只由使用者修改,两者均为自由递增计数,取模得到下标
+    std::atomic<uint32_t> rx_written_ = 0;
+    uint32_t rx_read_                 = 0;
+    uint16_t rx_last_pos_             = 0;
+
+    // 发送队列: 队头帧在DMA发送完成前一直占用其缓冲区
+    static constexpr size_t TX_QUEUE_DEPTH = 4;
+    static constexpr size_t TX_FRAME_SIZE  = 64;
+    uint8_t tx_pool_[TX_QUEUE_DEPTH][TX_FRAME_SIZE];
+    uint16_t tx_length_[TX_QUEUE_DEPTH] = {};
+    uint8_t tx_head_                    = 0;
+    volatile uint8_t tx_count_          = 0;
+    bool tx_busy_                       = false;
+
+    // 链路统计与自动恢复: 中断和使用者上报的错误累计为连续错误,收到有效帧时清零
+    uart_link_stats stats_          = {};
+    uint8_t recovery_threshold_     = 0;
+    uint8_t consecutive_errors_     = 0;
+    volatile bool recovery_pending_ = false;
+
+    uart_base(UART_HandleTypeDef* handle, uint16_t rx_size, UART_RX_MODE rx_mode,
+              uint8_t recovery_threshold)
         : uart_handle_(handle)
-        , rx_size_(rx_size < MAX_RX_BUFFER_SIZE ? rx_size : MAX_RX_BUFFER_SIZE) {
-        register_instance(this);
+        , rx_size_(rx_size < MAX_RX_BUFFER_SIZE ? rx_size : MAX_RX_BUFFER_SIZE)
+        , rx_mode_(rx_mode)
+        , recovery_threshold_(recovery_threshold) {
+        uart_instances_.Register(instance_key(handle->Instance), this);
     }
 
-    static void register_instance(uart_base* instance) {
-        if (uart_instance_count_ < MAX_UART_INSTANCES) {
-            uart_instances_[uart_instance_count_++] = instance;
+    // 关中断或在发送完成中断中调用;外设被其他发送方式占用时保留队头,待下次Submit重试
+    void start_next_tx() {
+        if (tx_count_ == 0) {
+            tx_busy_ = false;
+            return;
         }
+        tx_busy_ = HAL_UART_Transmit_DMA(uart_handle_, tx_pool_[tx_head_], tx_length_[tx_head_])
+                == HAL_OK;
+    }
+    void finish_tx() {
+        tx_head_  = (tx_head_ + 1) % TX_QUEUE_DEPTH;
+        tx_count_ = tx_count_ - 1;
+        start_next_tx();
     }
 
-    static void unregister_instance(uart_base* instance) {
-        for (size_t i = 0; i < uart_instance_count_; ++i) {
-            if (uart_instances_[i] == instance) {
-                for (size_t j = i; j < uart_instance_count_ - 1; ++j) {
-                    uart_instances_[j] = uart_instances_[j + 1];
-                }
-                --uart_instance_count_;
-                break;
-            }
+    // HT/TC/IDLE事件中Size为DMA在缓冲区内的写入位置,与上次位置之差即新到字节数
+    void publish_ring(uint16_t size) {
+        auto pos     = static_cast<uint16_t>(size & (RX_RING_SIZE - 1));
+        auto arrived = static_cast<uint16_t>((pos - rx_last_pos_) & (RX_RING_SIZE - 1));
+        rx_last_pos_ = pos;
+        stats_.rx_bytes += arrived;
+        rx_written_.store(rx_written_.load(std::memory_order_relaxed) + arrived,
+                          std::memory_order_release);
+    }
+    void start_ring() {
+        HAL_UARTEx_ReceiveToIdle_DMA(uart_handle_, rx_buffer_, RX_RING_SIZE);
+    }
+    // 出错后HAL已中止DMA,重启后从缓冲区起点写入,写计数对齐到整圈使下标保持一致;
+    // 对齐跳过的旧字节由使用者按帧头和校验丢弃
+    void restart_ring() {
+        uint32_t written = rx_written_.load(std::memory_order_relaxed);
+        rx_written_.store((written + RX_RING_SIZE - 1) & ~(RX_RING_SIZE - 1),
+                          std::memory_order_release);
+        rx_last_pos_ = 0;
+        start_ring();
+    }
+
+    // USART1~3依次对应键0~2
+    static size_t instance_key(const USART_TypeDef* usart) {
+        if (usart == USART1) {
+            return 0;
+        }
+        if (usart == USART2) {
+            return 1;
         }
+        if (usart == USART3) {
+            return 2;
+        }
+        return MAX_UART_INSTANCES;
     }
 
 private:
     static constexpr size_t MAX_UART_INSTANCES = 3;
-    static uart_base* uart_instances_[MAX_UART_INSTANCES];
-    static size_t uart_instance_count_;
+    static tool::registry<uart_base, MAX_UART_INSTANCES> uart_instances_;
+
+    // HAL和快速中断路径共用的接收事件/错误/发送完成处理
+    void dispatch_rx_event(uint16_t size);
+    void dispatch_error(uint32_t error_code);
+    // 关中断或在中断中调用
+    void count_error() {
+        if (recovery_threshold_ != 0 && ++consecutive_errors_ >= recovery_threshold_) {
+            recovery_pending_ = true;
+        }
+    }
+    void dispatch_tx_complete() {
+        if (tx_busy_) {
+            finish_tx();
+        }
+    }
 
     friend void ::HAL_UARTEx_RxEventCallback(UART_HandleTypeDef* huart, uint16_t Size);
     friend void ::HAL_UART_ErrorCallback(UART_HandleTypeDef* huart);
+    friend void ::HAL_UART_TxCpltCallback(UART_HandleTypeDef* huart);
+#if BSP_FAST_IRQ_ENABLED
+    friend bool ::BSP_FastIRQ_UART(UART_HandleTypeDef* huart);
+    friend bool ::BSP_FastIRQ_UART_DMA(DMA_HandleTypeDef* hdma);
+#endif
 };
 
 // 模板类
@@ -100,12 +349,15 @@ public:
     struct uart_params {
         UART_HandleTypeDef* uart_handle = nullptr;
         uint16_t recv_buff_size         = MAX_RX_BUFFER_SIZE;
+        UART_RX_MODE rx_mode            = UART_RX_MODE::ONESHOT;
+        uint8_t recovery_threshold      = 8; // 连续错误达到该次数后自动恢复,0表示不自动恢复
         Derived* callback_instance      = nullptr;
         CallbackFunction callback       = nullptr;
     };
 
     explicit uart(const uart_params& params)
-        : uart_base(params.uart_handle, params.recv_buff_size)
+        : uart_base(
+              params.uart_handle, params.recv_buff_size, params.rx_mode, params.recovery_threshold)
         , callback_instance_(params.callback_instance)
         , callback_function_(params.callback) {}
 
@@ -1,27 +1,52 @@
 #pragma once
 
 #include "bsp/can/can.hpp"
+#include "bsp/can/isotp.hpp"
 #include "package.hpp"
+#include "tool/deadline.hpp"
+#include "tool/profile/profile.hpp"
 
+#include <chrono>
 #include <cstring>
 
 namespace device {
+using namespace std::chrono_literals;
+
 class can_comm {
 public:
     struct can_comm_params {
         bsp::can<can_comm>::can_params can_params;
+        bsp::isotp_base::isotp_params transport_params; // 超过单帧的报文(用户ID、日志、模板等)
+        // 须与总线上其他节点一致;Begin中按此覆盖CubeMX生成的位时序
+        bsp::can_bitrate bitrate = bsp::can_bitrate::k125;
         can_comm_params() {
-            can_params.can_handle = &hcan;
-            can_params.tx_id      = 0x102;
-            can_params.rx_id      = 0x101;
+            can_params.can_handle       = &hcan;
+            can_params.tx_id            = 0x102;
+            can_params.rx_id            = 0x101;
+            transport_params.can_handle = &hcan;
+            transport_params.tx_id      = 0x106;
+            transport_params.rx_id      = 0x105;
+            transport_params.block_size = 8;
+            transport_params.st_min     = 0;
         }
     };
     explicit can_comm(const can_comm_params& params)
-        : can_(params.can_params) {
+        : bitrate_(params.bitrate)
+        , can_(params.can_params)
+        , transport_(params.transport_params) {
         can_.SetCallback(this, &can_comm::decode);
     }
     ~can_comm() = default;
-    void Begin() { can_.Begin(); }
+    void Begin() {
+        bsp::can_base::SetBitrate(bitrate_);
+        can_.Begin();
+        transport_.Begin();
+    }
+    // 推进分段发送并发布状态表,在主循环中调用
+    void poll() {
+        transport_.Poll();
+        publish_status();
+    }
     void send_identify_success() {
         uint8_t tx_data = 0x01;
         can_.Transmit(&tx_data, sizeof(tx_data), 0x100); // 最高优先级
@@ -30,9 +55,12 @@ public:
         auto tx_data = static_cast<uint8_t>(req);
         can_.Transmit(&tx_data, sizeof(tx_data), 0x102);
     }
-    void send_status(uint8_t seq, uint8_t status) {
-        uint8_t tx_data[2] = {seq, status};
-        can_.Transmit(tx_data, sizeof(tx_data), 0x104);
+    // 更新状态表中的字段,只写入值,可在中断中调用;变化由poll发布
+    void set_status(status_field field, uint8_t value) {
+        auto index = static_cast<uint8_t>(static_cast<uint8_t>(field) - 1);
+        if (index < STATUS_FIELD_COUNT) {
+            status_values_[index] = value;
+        }
     }
 
     [[nodiscard]] bool get_finger_enroll_flag() {
@@ -52,12 +80,114 @@ public:
         }
         return false;
     }
+    // 分段传输,发送未结束时返回false
+    bool send_message(const uint8_t* data, size_t length) { return transport_.Send(data, length); }
+    [[nodiscard]] bool is_message_available() const { return transport_.Available(); }
+    [[nodiscard]] tool::frame_view get_message() const { return transport_.View(); }
+    void release_message() { transport_.Release(); }
+    [[nodiscard]] bsp::isotp_stats get_transport_stats() const { return transport_.GetStats(); }
+
     void lock_rx_data() { data_locked_ = true; }
     void unlock_rx_data() { data_locked_ = false; }
 
 private:
-    void decode(uint8_t* rx_data, uint8_t length) {
-        if (length % 2 != 0) {
+    using clock = bsp::dwt::clock;
+
+    static constexpr uint32_t STATUS_ID    = 0x104;
+    static constexpr uint32_t HEARTBEAT_ID = 0x107;
+    static constexpr auto HEARTBEAT_PERIOD = 1s;
+    static constexpr auto STATUS_RETRY     = 10ms; // 发送队列满时的重试间隔
+    // 每个字段两次发送之间的最小间隔,间隔内的变化合并为一次,只发最新值
+    static constexpr clock::duration STATUS_MIN_INTERVAL[STATUS_FIELD_COUNT] = {
+        100ms, // human_detected, PIR抖动
+        0ms,   // finger_enroll_remaining
+        0ms,   // face_enrolling
+        0ms,   // finger_user_count
+        0ms,   // finger_link_negotiating
+        0ms,   // face_link_negotiating
+        1s,    // finger_link_recoveries
+        1s,    // face_link_recoveries
+        500ms, // can_bus_state
+    };
+
+    struct status_entry {
+        uint8_t published         = 0;
+        bool sent                 = false;
+        clock::time_point sent_at = {};
+    };
+
+    /**
+     * @brief 变化的字段按{序号, 值}打包,每帧最多4个,立即发送;受限的字段在间隔到期时再发
+     * @note 心跳帧{计数, 摘要, 序号, 值}每秒一次,摘要为全部已发布值的CRC-8,
+     *       并轮流附带一个字段,主机据此发现并修正镜像中的差异
+     */
+    void publish_status() {
+        auto now           = clock::now();
+        uint8_t tx_data[8] = {};
+        uint8_t length     = 0;
+        uint8_t pending[4] = {};
+        for (uint8_t i = 0; i < STATUS_FIELD_COUNT; ++i) {
+            status_entry& entry = status_entries_[i];
+            uint8_t value       = status_values_[i];
+            if (entry.sent && entry.published == value) {
+                continue;
+            }
+            if (entry.sent && now < entry.sent_at + STATUS_MIN_INTERVAL[i]) {
+                tool::daemon_base::RequestWakeup(entry.sent_at + STATUS_MIN_INTERVAL[i]);
+                continue;
+            }
+            pending[length / 2] = i;
+            tx_data[length++]   = static_cast<uint8_t>(i + 1);
+            tx_data[length++]   = value;
+            if (length == sizeof(tx_data)) {
+                flush_status(tx_data, length, pending, now);
+                length = 0;
+            }
+        }
+        if (length > 0) {
+            flush_status(tx_data, length, pending, now);
+        }
+
+        if (!heartbeat_.IsRunning() || heartbeat_.Expired()) {
+            uint8_t field        = heartbeat_count_ % STATUS_FIELD_COUNT;
+            uint8_t heartbeat[4] = {heartbeat_count_, status_digest(),
+                                    static_cast<uint8_t>(field + 1),
+                                    status_entries_[field].published};
+            if (can_.Transmit(heartbeat, sizeof(heartbeat), HEARTBEAT_ID)) {
+                ++heartbeat_count_;
+            }
+            heartbeat_.Start(HEARTBEAT_PERIOD);
+        }
+    }
+    void flush_status(const uint8_t* tx_data, uint8_t length, const uint8_t* fields,
+                      clock::time_point now) {
+        if (!can_.Transmit(tx_data, length, STATUS_ID)) {
+            tool::daemon_base::RequestWakeup(now + STATUS_RETRY);
+            return;
+        }
+        for (uint8_t k = 0; k < length / 2; ++k) {
+            status_entry& entry = status_entries_[fields[k]];
+            entry.published     = tx_data[2 * k + 1];
+            entry.sent          = true;
+            entry.sent_at       = now;
+        }
+    }
+    // CRC-8(多项式0x07)
+    [[nodiscard]] uint8_t status_digest() const {
+        uint8_t crc = 0;
+        for (const auto& entry : status_entries_) {
+            crc ^= entry.published;
+            for (int bit = 0; bit < 8; ++bit) {
+                crc = static_cast<uint8_t>(crc & 0x80 ? (crc << 1) ^ 0x07 : crc << 1);
+            }
+        }
+        return crc;
+    }
+
+    // 主循环中由bsp::can_base::ProcessRx调用,与各get_*_flag处于同一上下文
+    void decode(const bsp::can_rx_frame& frame) {
+        TOOL_PROFILE_ZONE("can_comm::decode");
+        if (frame.length % 2 != 0) {
             // 数据长度必须是偶数
             return;
         }
@@ -65,8 +195,8 @@ private:
             // 如果数据被锁定，则不进行解码
             return;
         }
-        auto len      = length;
-        auto data_ptr = rx_data;
+        auto len      = frame.length;
+        auto data_ptr = frame.data;
         while (len > 0) {
             if (data_ptr[0] <= sizeof(rx_status_)) {
                 reinterpret_cast<uint8_t*>(&rx_status_)[data_ptr[0] - 1] = data_ptr[1];
@@ -78,6 +208,12 @@ private:
 
     bool data_locked_    = false;
     rx_status rx_status_ = {};
+    bsp::can_bitrate bitrate_;
+    volatile uint8_t status_values_[STATUS_FIELD_COUNT] = {};
+    status_entry status_entries_[STATUS_FIELD_COUNT]    = {};
+    tool::timeout heartbeat_;
+    uint8_t heartbeat_count_ = 0;
     bsp::can<can_comm> can_;
+    bsp::isotp<256, 256> transport_;
 };
 } // namespace device
\ No newline at end of file
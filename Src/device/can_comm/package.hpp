@@ -18,4 +18,17 @@ enum class request : uint8_t {
     success_tone,
     test = 0xFF,
 };
+// 从机上报的状态字段,值即状态帧中的序号,帧格式与接收相同: {序号, 值}成对排列
+enum class status_field : uint8_t {
+    human_detected = 0x01,
+    finger_enroll_remaining, // 指纹注册剩余的采集次数,0为未在注册
+    face_enrolling,
+    finger_user_count,
+    finger_link_negotiating,
+    face_link_negotiating,
+    finger_link_recoveries,  // 串口链路恢复次数,饱和于255
+    face_link_recoveries,
+    can_bus_state,           // bsp::can_bus_state
+};
+inline constexpr uint8_t STATUS_FIELD_COUNT = 9;
 } // namespace device
\ No newline at end of file
@@ -6,95 +6,65 @@
 #include "bsp/uart/uart.hpp"
 #include "device/face/package.hpp"
 #include "device/finger/finger.hpp"
+#include "tool/coro/coro.hpp"
+#include "tool/profile/profile.hpp"
 
 #include <array>
 #include <cstring>
 
 namespace device {
+using namespace std::chrono_literals;
 class face {
 public:
     enum class face_states : uint8_t { idle, busy, error, invalid };
     struct face_params {
         bsp::uart<face>::uart_params uart_params;
         bsp::gpio<face>::gpio_params INT_params;
+        bsp::uart_baud_policy baud_policy;
         face_params() {
             uart_params.uart_handle    = &huart2;
             uart_params.recv_buff_size = sizeof(face_reply_package);
+            uart_params.rx_mode        = bsp::UART_RX_MODE::RING;
             INT_params.GPIOx           = GPIOB;
             INT_params.GPIO_Pin        = GPIO_PIN_14;
+            baud_policy.safe           = 115200;
+            // 0x51的速率序号表未经实机确认,默认不协商;确认后可改为460800(APB1 36MHz下误差0.16%)
+            baud_policy.target         = 115200;
         }
     };
     explicit face(const face_params& params)
         : uart_(params.uart_params)
         , gpio_(params.INT_params)
-        , identify_daemon_(21, this, &face::identify) {
+        , baud_policy_(params.baud_policy)
+        , identify_daemon_(
+              21s, this, &face::identify, tool::daemon_base::mode::deferred, "face::identify") {
         uart_.SetCallback(this, &face::decode_IT_set);
-        uart_.set_dma_rx_buffer(reinterpret_cast<uint8_t*>(&rx_package));
         gpio_.SetCallback(this, &face::human_detect_IT_set);
         identify_daemon_.Pause();
     }
     ~face() = default;
     void Begin() { uart_.Begin(); }
 
-    void enroll_interactive() {
-        // clang-format off
-        constexpr std::array<enroll_params::face_direction, 5> directions = {
-            enroll_params::face_direction::Front,
-            enroll_params::face_direction::Up,
-            enroll_params::face_direction::Down,
-            enroll_params::face_direction::Left,
-            enroll_params::face_direction::Right
-        };
-        // clang-format on
-        enroll_params params = {};
-        this->reset();
-        DWT_Delay(2.5);
-        app::can_comm_instance->send_request(request::enroll_prompt);
-        DWT_Delay(0.5);
-
-        rx_package.set_zero();
-        // uart_.set_dma_rx_buffer(reinterpret_cast<uint8_t*>(&rx_package));
-        uart_.ReceiveDMAAuto();
+    // 启动链路速率协商,完成前暂停识别与注册
+    void negotiate_baud() {
+        if (link_negotiating_) {
+            return;
+        }
+        link_negotiating_ = true;
+        if (!tool::coro::executor::Spawn(link_flow())) {
+            link_negotiating_ = false;
+        }
+    }
 
-        for (const auto& dir : directions) {
-            enroll_unexpected_exit_ = false;
-            enroll_single_success_  = false;
-            params.set_direction(dir);
-            this->enroll(params);
-            is_enrolling_ = true;
-            app::can_comm_instance->lock_rx_data();
-            auto now                = DWT_GetTimeline_s();
-            constexpr float timeout = 20.0f;
-            while (!enroll_single_success_) {
-                if (enroll_unexpected_exit_) {
-                    if (finger_) {
-                        finger_->set_notice(finger::LED_states::wrong);
-                        app::can_comm_instance->send_request(request::wrong_tone);
-                    }
-                    is_enrolling_ = false;
-                    app::can_comm_instance->unlock_rx_data();
-                    return;
-                }
-                if (DWT_GetTimeline_s() - now > timeout) {
-                    this->reset();
-                    if (finger_) {
-                        finger_->set_notice(finger::LED_states::wrong);
-                        app::can_comm_instance->send_request(request::wrong_tone);
-                    }
-                    is_enrolling_ = false;
-                    app::can_comm_instance->unlock_rx_data();
-                    return;
-                }
-            }
-            if (finger_) {
-                app::can_comm_instance->send_request(request::short_prompt);
-                finger_->set_notice(finger::LED_states::success);
-            }
-            DWT_Delay(2);
+    // 启动交互式注册流程,后续步骤由协程在主循环中推进
+    void enroll_interactive() {
+        if (is_enrolling_ || link_negotiating_) {
+            return;
+        }
+        is_enrolling_ = true;
+        if (!tool::coro::executor::Spawn(enroll_flow())) {
+            is_enrolling_ = false;
         }
-        app::can_comm_instance->send_request(request::long_prompt);
-        is_enrolling_ = false;
-        app::can_comm_instance->unlock_rx_data();
     }
 
     void enroll(enroll_params data) {
@@ -105,7 +75,18 @@ public:
     }
 
     void reset() { this->send_package(0x10); }
-    void get_status() { this->send_package(0x11); }
+    void get_status() {
+        link_ack_ = false;
+        this->send_package(0x11);
+    }
+    // 模组以原速率应答后切换,不支持的速率不发送
+    void set_baud_rate(uint32_t baud_rate) {
+        uint8_t index = baud_rate_index(baud_rate);
+        link_ack_     = false;
+        if (index != 0) {
+            this->send_package(0x51, &index, sizeof(index));
+        }
+    }
     void delete_all() { this->send_package(0x21); }
     void set_USB_UVC_parameters(face_USB_UAC_params data) {
         this->send_package(0xB1, reinterpret_cast<uint8_t*>(&data), sizeof(data));
@@ -120,32 +101,58 @@ public:
         } else {
             identify_daemon_.Pause();
         }
-        if (is_enrolling_ == false) {
+        if (is_enrolling_ == false && link_negotiating_ == false) {
             this->verify(verify_params());
         }
     }
+    // 从接收环中按帧头和长度切出完整消息原地解析,不完整的消息留待下次接收事件;
+    // 超出接收包长度的消息(如图像)在到达时直接跳过
     void decode() {
-        if (size < sizeof(face_package::SOF) + sizeof(face_package::MsgID)
-                       + sizeof(face_package::data_length) + sizeof(uint8_t)) {
-            return;
-        }
-
-        if (!validate_header(rx_package)) {
-            return;
-        }
-
-        if (!validate_parity_check(rx_package, size)) {
-            return;
+        TOOL_PROFILE_ZONE("face::decode");
+        constexpr size_t header_size = sizeof(face_package::SOF) + sizeof(face_package::MsgID)
+                                     + sizeof(face_package::data_length);
+        while (true) {
+            if (rx_skip_ > 0) {
+                rx_skip_ -= uart_.Skip(rx_skip_);
+                if (rx_skip_ > 0) {
+                    return;
+                }
+            }
+            size_t available = uart_.Available();
+            if (available < header_size) {
+                return;
+            }
+            if (uart_.Peek(0) != 0xEF || uart_.Peek(1) != 0xAA) {
+                uart_.Skip(1); // 重新同步到帧头
+                continue;
+            }
+            size_t length = header_size + (uart_.Peek(3) << 8 | uart_.Peek(4)) + sizeof(uint8_t);
+            if (length > sizeof(face_reply_package)) {
+                rx_skip_ = length;
+                continue;
+            }
+            if (available < length) {
+                return;
+            }
+            {
+                TOOL_PROFILE_ZONE("face::frame");
+                face_reply_view package(uart_.View(length));
+                bool valid = validate_header(package) && validate_parity_check(package);
+                uart_.ReportFrame(valid);
+                if (valid) {
+                    process_response(package);
+                }
+            }
+            uart_.Skip(length);
         }
-        process_response(rx_package);
-
-        rx_package.set_zero();
-        uart_.ReceiveDMAAuto();
     }
 
     [[nodiscard]] bool is_init_finished() const { return Init_finished_; }
     [[nodiscard]] face_states get_face_state() const { return face_state_; }
     [[nodiscard]] bool is_enrolling() const { return is_enrolling_; }
+    [[nodiscard]] bool is_link_negotiating() const { return link_negotiating_; }
+    [[nodiscard]] uint32_t get_baud_rate() const { return uart_.GetBaudRate(); }
+    [[nodiscard]] bsp::uart_link_stats get_link_stats() const { return uart_.GetStats(); }
     [[nodiscard]] bool is_waiting_identify() {
         if (waiting_identify_) {
             waiting_identify_ = false;
@@ -162,49 +169,53 @@ public:
     }
 
 private:
-    inline static bool validate_header(const face_reply_package& package) {
-        return package.SOF == 0xEFAA;
+    inline static bool validate_header(const face_reply_view& package) {
+        return package.SOF() == 0xEFAA;
     }
-    inline static bool validate_parity_check(const face_reply_package& package, uint16_t size) {
-        uint8_t parity_check_ = parity_check(reinterpret_cast<const uint8_t*>(&package), size - 1);
-        uint8_t offset        = package.data_length;
-        offset -= sizeof(face_reply_package::result) + sizeof(face_reply_package::mid);
-        return parity_check_ == package.data[offset];       // attention big endian bug
+    inline static bool validate_parity_check(const face_reply_view& package) {
+        return package.calculate_parity() == package.parity();
     }
-    inline void process_response(const face_reply_package& package) {
-        if (package.ID == face_reply_package::MsgID::image) // 暂不处理图像信息
+    inline void process_response(const face_reply_view& package) {
+        if (package.ID() == face_reply_view::MsgID::image) // 暂不处理图像信息
             return;
-        else if (package.ID == face_reply_package::MsgID::note) {
+        else if (package.ID() == face_reply_view::MsgID::note) {
             // 仅处理ready消息
-            if (package.mid == 0) {
+            if (package.mid() == 0) {
                 Init_finished_ = true;
             }
-        } else if (package.ID == face_reply_package::MsgID::reply) {
-            switch (package.mid) {
-            case 0x11: process_get_status_response(package); break;
+        } else if (package.ID() == face_reply_view::MsgID::reply) {
+            switch (package.mid()) {
+            case 0x11:
+                link_ack_ = package.result() == face_result::success;
+                process_get_status_response(package);
+                break;
             case 0x12: process_verify_response(package); break;
             case 0x13: process_enroll_response(package); break;
+            case 0x51: link_ack_ = package.result() == face_result::success; break;
             default: break;
             }
         }
     }
-    inline void process_get_status_response(const face_reply_package& package) {
-        face_state_ = static_cast<face_states>(package.data[0]);
+    inline void process_get_status_response(const face_reply_view& package) {
+        face_state_ = static_cast<face_states>(package.data(0));
     }
-    static inline void process_verify_response(const face_reply_package& package) {
-        if (package.result == face_result::success) {
+    static inline void process_verify_response(const face_reply_view& package) {
+        if (package.result() == face_result::success) {
             app::identify_success = true;
         }
     }
-    inline void process_enroll_response(const face_reply_package& package) {
-        if (package.result == face_result::success) {
+    inline void process_enroll_response(const face_reply_view& package) {
+        if (package.result() == face_result::success) {
             enroll_single_success_ = true;
         } else {
             enroll_unexpected_exit_ = true;
             this->reset();
         }
     }
-    void send_package(const uint8_t MsgID, const uint8_t* data = nullptr, uint16_t length = 0) {
+    // 帧复制进串口发送队列后返回,不再依赖栈上缓冲区在DMA期间保持有效
+    bsp::UART_TX_RESULT send_package(const uint8_t MsgID, const uint8_t* data = nullptr,
+                                     uint16_t length = 0) {
+        TOOL_PROFILE_ZONE("face::send_package");
         face_package package;
         package.data_length = length;
         package.MsgID       = MsgID;
@@ -217,9 +228,8 @@ private:
         uint8_t parity_check_ =
             this->parity_check(reinterpret_cast<uint8_t*>(&package), header_length + length);
         package.data[length] = parity_check_;
-        uart_.Send(
-            reinterpret_cast<uint8_t*>(&package), header_length + length + sizeof(parity_check_),
-            bsp::UART_TRANSFER_MODE::DMA);
+        return uart_.Submit(
+            reinterpret_cast<uint8_t*>(&package), header_length + length + sizeof(parity_check_));
     }
     static uint8_t parity_check(const uint8_t* data, uint16_t length) {
         constexpr uint8_t parity_check_offset = sizeof(face_package::SOF);
@@ -231,23 +241,134 @@ private:
         }
         return parity;
     }
+    // MID_CONFIG_BAUDRATE的速率序号,0表示不支持
+    static constexpr uint8_t baud_rate_index(uint32_t baud_rate) {
+        switch (baud_rate) {
+        case 115200: return 1;
+        case 230400: return 2;
+        case 460800: return 3;
+        case 1500000: return 4;
+        default: return 0;
+        }
+    }
+    // 等待状态查询或速率设置的应答
+    auto link_reply() {
+        return tool::coro::wait([this] { return link_ack_; }, 300ms);
+    }
+    // 发送队列清空后才能切换速率,切换时接收环被清空,未跳完的长消息一并作废
+    auto switch_baud(uint32_t baud_rate) {
+        return tool::coro::wait(
+            [this, baud_rate] {
+                if (!uart_.SetBaudRate(baud_rate)) {
+                    return false;
+                }
+                rx_skip_ = 0;
+                return true;
+            },
+            200ms);
+    }
+    tool::coro::task link_flow() {
+        const uint32_t safe   = baud_policy_.safe;
+        const uint32_t target = baud_policy_.target;
+        uint32_t linked       = 0;
+        // 写入的速率会保存在模组中,上电后依次在出厂速率和目标速率下查询状态
+        for (uint32_t baud_rate : {safe, target}) {
+            if (!co_await switch_baud(baud_rate)) {
+                continue; // 本地未能切换,该速率下查询没有意义
+            }
+            this->get_status();
+            if (co_await link_reply()) {
+                linked = baud_rate;
+                break;
+            }
+        }
+        if (linked == safe && target != safe && baud_rate_index(target) != 0) {
+            this->set_baud_rate(target);
+            if (co_await link_reply()) {
+                // 模组应答后已按新速率运行并保存,先在新速率下重试,都失败才退回出厂速率
+                linked = 0;
+                for (int attempt = 0; attempt < 3 && linked == 0; ++attempt) {
+                    if (!co_await switch_baud(target)) {
+                        continue;
+                    }
+                    co_await tool::coro::delay(50ms);
+                    this->get_status();
+                    linked = co_await link_reply() ? target : 0;
+                }
+                if (linked == 0 && co_await switch_baud(safe)) {
+                    this->get_status();
+                    linked = co_await link_reply() ? safe : 0;
+                }
+            }
+        }
+        if (linked == 0) {
+            co_await switch_baud(safe);
+        }
+        link_negotiating_ = false;
+    }
+    tool::coro::task enroll_flow() {
+        // clang-format off
+        static constexpr std::array<enroll_params::face_direction, 5> directions = {
+            enroll_params::face_direction::Front,
+            enroll_params::face_direction::Up,
+            enroll_params::face_direction::Down,
+            enroll_params::face_direction::Left,
+            enroll_params::face_direction::Right
+        };
+        // clang-format on
+        enroll_params_ = {};
+        this->reset();
+        co_await tool::coro::delay(2500ms);
+        app::can_comm_instance->send_request(request::enroll_prompt);
+        co_await tool::coro::delay(500ms);
+
+        for (auto dir : directions) {
+            enroll_unexpected_exit_ = false;
+            enroll_single_success_  = false;
+            enroll_params_.set_direction(dir);
+            this->enroll(enroll_params_);
+            app::can_comm_instance->lock_rx_data();
+
+            bool replied = co_await tool::coro::wait(
+                [this] { return enroll_single_success_ || enroll_unexpected_exit_; }, 20s);
+            if (!replied) {
+                this->reset();
+            }
+            if (!replied || enroll_unexpected_exit_) {
+                enroll_finish(false);
+                co_return;
+            }
+            if (finger_) {
+                app::can_comm_instance->send_request(request::short_prompt);
+                finger_->set_notice(finger::LED_states::success);
+            }
+            co_await tool::coro::delay(2s);
+        }
+        enroll_finish(true);
+    }
+    void enroll_finish(bool success) {
+        if (success) {
+            app::can_comm_instance->send_request(request::long_prompt);
+        } else if (finger_) {
+            finger_->set_notice(finger::LED_states::wrong);
+            app::can_comm_instance->send_request(request::wrong_tone);
+        }
+        is_enrolling_ = false;
+        app::can_comm_instance->unlock_rx_data();
+    }
     void human_detect_IT_set() {
         app::human_detected = HAL_GPIO_ReadPin(GPIOB, GPIO_PIN_14);
-        app::can_comm_instance->send_status(0x01, app::human_detected);
+        // 中断中只写状态表,由主循环的can_comm.poll()按变化发布
+        app::can_comm_instance->set_status(status_field::human_detected, app::human_detected);
         if (app::human_detected) {
             waiting_identify_ = true;
         }
     }
-    void decode_IT_set() {
-        waiting_decode_ = true;
-        size            = uart_.GetTrueRxSize();
-        if (is_enrolling_) {
-            this->decode();
-            waiting_decode_ = false;
-        }
-    }
+    // 接收环只能由主循环读取,中断中仅置位,注册期间主循环不再阻塞,无需在中断中解码
+    void decode_IT_set() { waiting_decode_ = true; }
     bsp::uart<face> uart_;
     bsp::gpio<face> gpio_;
+    bsp::uart_baud_policy baud_policy_;
     device::finger* finger_ = nullptr;
     tool::daemon<face> identify_daemon_;
 
@@ -257,8 +378,12 @@ private:
     bool waiting_identify_ = true;
     bool waiting_decode_   = false;
 
-    uint16_t size                 = 0;
-    face_reply_package rx_package = {};
+    bool link_negotiating_ = false;
+    bool link_ack_         = false;
+
+    size_t rx_skip_ = 0;
+
+    enroll_params enroll_params_ = {};
 
     bool enroll_unexpected_exit_ = false;
     bool enroll_single_success_  = false;
@@ -2,6 +2,7 @@
 
 #include "stm32f1xx_hal.h"
 #include "tool/endian_promise.hpp"
+#include "tool/frame_view.hpp"
 #include <cstring>
 #include <random>
 
@@ -40,7 +41,36 @@ struct __attribute__((packed)) face_reply_package {
     uint8_t mid;
     face_result result;
     uint8_t data[126] = {};       // 末尾加奇偶校验
-    void set_zero() { std::memset(this, 0, sizeof(face_reply_package)); }
+};
+// 回复包的零拷贝视图,字段按协议偏移直接从接收环读取,布局与face_reply_package一致
+class face_reply_view {
+public:
+    using MsgID = face_reply_package::MsgID;
+
+    constexpr explicit face_reply_view(frame_view frame)
+        : frame_(frame) {}
+
+    [[nodiscard]] constexpr uint16_t SOF() const { return frame_.BE16(0); }
+    [[nodiscard]] constexpr MsgID ID() const { return static_cast<MsgID>(frame_.At(2)); }
+    [[nodiscard]] constexpr uint16_t data_length() const { return frame_.BE16(3); }
+    [[nodiscard]] constexpr uint8_t mid() const { return frame_.At(5); }
+    [[nodiscard]] constexpr face_result result() const {
+        return static_cast<face_result>(frame_.At(6));
+    }
+    [[nodiscard]] constexpr uint8_t data(size_t index) const { return frame_.At(7 + index); }
+    [[nodiscard]] constexpr uint8_t parity() const { return frame_.At(frame_.Size() - 1); }
+    [[nodiscard]] constexpr size_t size() const { return frame_.Size(); }
+    // 奇偶校验覆盖帧头之后到校验字节之前的所有字节
+    [[nodiscard]] constexpr uint8_t calculate_parity() const {
+        uint8_t parity = 0;
+        for (size_t i = 2; i + 1 < frame_.Size(); ++i) {
+            parity ^= frame_.At(i);
+        }
+        return parity;
+    }
+
+private:
+    frame_view frame_;
 };
 
 struct __attribute__((packed)) verify_params {
@@ -4,13 +4,17 @@
 #include "bsp/gpio/gpio.hpp"
 #include "bsp/uart/uart.hpp"
 #include "device/finger/package.hpp"
+#include "tool/coro/coro.hpp"
+#include "tool/deadline.hpp"
 #include "tool/deamon/daemon.hpp"
 #include "tool/endian_promise.hpp"
+#include "tool/profile/profile.hpp"
 
 #include <cstring>
 
 namespace device {
 using namespace tool;
+using namespace std::chrono_literals;
 class finger {
 public:
     enum class LED_states : uint8_t {
@@ -22,42 +26,61 @@ public:
     struct finger_params {
         bsp::uart<finger>::uart_params uart_params;
         bsp::gpio<finger>::gpio_params INT_params;
+        bsp::uart_baud_policy baud_policy;
         finger_params() {
             uart_params.uart_handle    = &huart1;
             uart_params.recv_buff_size = sizeof(finger_ACK_package);
+            uart_params.rx_mode        = bsp::UART_RX_MODE::RING;
             INT_params.GPIOx           = GPIOA;
             INT_params.GPIO_Pin        = GPIO_PIN_8;
+            baud_policy.safe           = 57600;
+            baud_policy.target         = 115200; // 模组支持N×9600,N最大为12
         }
     };
     explicit finger(const finger_params& params)
         : uart_(params.uart_params)
         , gpio_(params.INT_params)
-        , LED_daemon_(1, this, &finger::set_LED_states)
-        , EXTI_daemon_(1, this, &finger::allow_verify)
-        , enroll_daemon_(20, this, &finger::enroll_fallback) {
+        , baud_policy_(params.baud_policy)
+        , LED_daemon_(
+              1s, this, &finger::set_LED_states, tool::daemon_base::mode::deferred, "finger::LED")
+        , EXTI_daemon_(
+              1s, this, &finger::allow_verify, tool::daemon_base::mode::immediate, "finger::EXTI")
+        , enroll_daemon_(20s, this, &finger::enroll_fallback, tool::daemon_base::mode::deferred,
+                         "finger::enroll") {
         enroll_daemon_.Pause();
         LED_daemon_.Pause();
         uart_.SetCallback(this, &finger::decode_IT_set);
-        uart_.set_dma_rx_buffer(reinterpret_cast<uint8_t*>(&rx_package));
         gpio_.SetCallback(this, &finger::identify_IT_set);
     }
     ~finger() = default;
     void Begin() { uart_.Begin(); }
 
+    // 启动链路速率协商,完成前暂停识别与注册,结束后读取用户数
+    void negotiate_baud() {
+        if (link_negotiating_) {
+            return;
+        }
+        link_negotiating_ = true;
+        if (!tool::coro::executor::Spawn(link_flow())) {
+            link_negotiating_ = false;
+            this->get_user_count();
+        }
+    }
+
+    // 启动注册流程,后续步骤由协程在主循环中推进
     void auto_enroll(finger_auto_enroll_params data) {
-        LED_daemon_.Pause();
-        DWT_Delay(3.5);
-        app::can_comm_instance->send_request(request::enroll_prompt);
-        DWT_Delay(1.5);
-        data.ID             = ++user_count_;
-        enroll_times_count_ = data.times;
-        enroll_success_     = false;
-        is_enrolling_       = true;
-        app::can_comm_instance->lock_rx_data();
-        this->LED_control(finger_led_params().set_mode(LED_modes::AlwaysOff));
-        DWT_Delay(0.05);
-        enroll_daemon_.Resume();
-        this->send_package(0x31, reinterpret_cast<uint8_t*>(&data), sizeof(data));
+        if (enroll_preparing_ || is_enrolling_ || link_negotiating_) {
+            return;
+        }
+        enroll_preparing_ = true;
+        if (!tool::coro::executor::Spawn(enroll_flow(data))) {
+            enroll_preparing_ = false;
+        }
+    }
+    void poll() {
+        if (notice_timeout_.Expired()) {
+            set_notice(LED_states::success);
+        }
     }
     void auto_identify(finger_auto_identify_params data) {
         this->send_package(0x32, reinterpret_cast<uint8_t*>(&data), sizeof(data));
@@ -79,40 +102,71 @@ public:
         this->send_package(0x3C, reinterpret_cast<uint8_t*>(&data), sizeof(data));
     }
     void delete_all() { this->send_package(0x0D); }
-    void handshake() { this->send_package(0x35); }
+    void handshake() {
+        link_ack_ = false;
+        this->send_package(0x35);
+    }
+    // 写系统寄存器4(波特率控制,N×9600),模组以原速率应答后切换
+    void set_baud_rate(uint32_t baud_rate) {
+        uint8_t data[2] = {4, static_cast<uint8_t>(baud_rate / 9600)};
+        link_ack_       = false;
+        this->send_package(0x0E, data, sizeof(data));
+    }
     void sleep() { this->send_package(0x33); }
 
     void identify() {
-        if (!is_enrolling_ && allow_verify_) {
+        if (!is_enrolling_ && !enroll_preparing_ && !link_negotiating_ && allow_verify_) {
             this->auto_identify(finger_auto_identify_params());
             allow_verify_ = false;
             EXTI_daemon_.Reload();
         }
     }
+    // 从接收环中按帧头和长度切出完整应答包,原地解析后跳过,不完整的包留待下次接收事件
     void decode() {
-        if (size_ < sizeof(finger_ACK_package::header)) {
-            reset_state();
-            return;
-        }
-
-        if (!validate_header(rx_package)) {
-            reset_state();
-            return;
-        }
-
-        if (!validate_checksum(rx_package, size_)) {
-            reset_state();
-            return;
+        TOOL_PROFILE_ZONE("finger::decode");
+        constexpr size_t header_size = finger_ACK_view::HEADER_SIZE;
+        constexpr size_t min_size    = finger_ACK_view::DATA_OFFSET + 2;
+        while (true) {
+            size_t available = uart_.Available();
+            if (available < header_size) {
+                return;
+            }
+            if (uart_.Peek(0) != 0xEF || uart_.Peek(1) != 0x01) {
+                uart_.Skip(1); // 重新同步到帧头
+                continue;
+            }
+            size_t size = header_size + (uart_.Peek(7) << 8 | uart_.Peek(8));
+            if (size < min_size || size > sizeof(finger_ACK_package)) {
+                uart_.Skip(1);
+                continue;
+            }
+            if (available < size) {
+                return;
+            }
+            {
+                TOOL_PROFILE_ZONE("finger::frame");
+                finger_ACK_view package(uart_.View(size));
+                bool valid = validate_header(package) && validate_checksum(package);
+                uart_.ReportFrame(valid);
+                if (valid) {
+                    process_response(package);
+                } else {
+                    reset_state();
+                }
+            }
+            uart_.Skip(size);
         }
-        process_response(rx_package);
-
-        rx_package.set_zero();
-        uart_.ReceiveDMAAuto();
     }
 
     [[nodiscard]] bool is_received() const { return waiting_ack_cmd_ == 0; }
     [[nodiscard]] uint8_t get_user_count() const { return user_count_; }
     [[nodiscard]] bool is_enroll_success() const { return enroll_success_; }
+    [[nodiscard]] uint8_t get_enroll_remaining() const {
+        return is_enrolling_ ? enroll_times_count_ : 0;
+    }
+    [[nodiscard]] bool is_link_negotiating() const { return link_negotiating_; }
+    [[nodiscard]] uint32_t get_baud_rate() const { return uart_.GetBaudRate(); }
+    [[nodiscard]] bsp::uart_link_stats get_link_stats() const { return uart_.GetStats(); }
 
     [[nodiscard]] bool is_waiting_identify() {
         if (waiting_identify_) {
@@ -131,7 +185,7 @@ public:
 
     inline void set_notice(LED_states state) {
         LED_state_ = state;
-        LED_daemon_.SetDt(0.2);
+        LED_daemon_.SetDt(200ms);
         LED_daemon_.Resume();
     }
     void set_LED_to_day() { LED_time_ = LED_time::day; }
@@ -141,25 +195,24 @@ public:
 
 private:
     inline void reset_state() { waiting_ack_cmd_ = 0; }
-    inline static bool validate_header(const finger_ACK_package& package) {
-        return package.header.SOF == 0xEF01 && package.header.address == finger_address;
+    inline static bool validate_header(const finger_ACK_view& package) {
+        return package.SOF() == 0xEF01 && package.address() == finger_address;
     }
-    inline static bool validate_checksum(const finger_ACK_package& package, uint16_t size) {
-        uint16_t checksum_calculated =
-            checksum(reinterpret_cast<const uint8_t*>(&package), size - 2);
-        uint16_t checksum_received =
-            *reinterpret_cast<const be_uint16_t*>(&package.data
-                                                       [size - sizeof(finger_ACK_package::header)
-                                                        - 2 - sizeof(finger_ACK_package::status)]);
-        return checksum_calculated == checksum_received;
+    inline static bool validate_checksum(const finger_ACK_view& package) {
+        return package.calculate_checksum() == package.checksum();
     }
-    inline void process_response(const finger_ACK_package& package) {
+    inline void process_response(const finger_ACK_view& package) {
         switch (waiting_ack_cmd_) {
         case 0x32: process_identify_response(package); break;
         case 0x31: process_enroll_response(package); break;
         case 0x1D: process_user_count_response(package); break;
+        case 0x35:
+        case 0x0E:
+            link_ack_ = package.status() == finger_status::OK;
+            reset_state();
+            break;
         default: { // 通用处理
-            if (package.status != finger_status::OK) {
+            if (package.status() != finger_status::OK) {
                 // error_handle
             }
             reset_state();
@@ -167,9 +220,9 @@ private:
         }
         }
     }
-    inline void process_identify_response(const finger_ACK_package& package) {
-        if (package.data[0] == 0x05) {
-            if (package.status == finger_status::OK) {
+    inline void process_identify_response(const finger_ACK_view& package) {
+        if (package.data(0) == 0x05) {
+            if (package.status() == finger_status::OK) {
                 app::identify_success = true;
                 // set_notice(LED_states::success);//不需要，因为在app_main中已经设置了
             } else {
@@ -179,8 +232,8 @@ private:
             reset_state();
         }
     }
-    inline void process_enroll_response(const finger_ACK_package& package) {
-        if (package.status != finger_status::OK) {
+    inline void process_enroll_response(const finger_ACK_view& package) {
+        if (package.status() != finger_status::OK) {
             is_enrolling_ = false;
             app::can_comm_instance->unlock_rx_data();
             enroll_times_count_ = 0;
@@ -191,32 +244,32 @@ private:
             return;
         }
 
-        if (package.data[0] == 0x03) {
+        if (package.data(0) == 0x03) {
             enroll_times_count_--;
             app::can_comm_instance->send_request(request::short_prompt);
-        } else if (package.data[0] == 0x02 && enroll_times_count_ == 1) {
+        } else if (package.data(0) == 0x02 && enroll_times_count_ == 1) {
             enroll_times_count_--;
             enroll_success_ = true;
             is_enrolling_   = false;
             app::can_comm_instance->unlock_rx_data();
             app::can_comm_instance->send_request(request::long_prompt);
-            DWT_Delay(0.5);
-            set_notice(LED_states::success);
+            notice_timeout_.Start(500ms);
             enroll_daemon_.Pause();
             reset_state();
         }
     }
-    inline void process_user_count_response(const finger_ACK_package& package) {
-        user_count_ = package.data[1];
+    inline void process_user_count_response(const finger_ACK_view& package) {
+        user_count_ = package.data(1);
         reset_state();
     }
 
-    void send_package(const uint8_t CMD, const uint8_t* data = nullptr, uint16_t length = 0) {
+    // 帧复制进串口发送队列后返回,队列满时不记录等待的应答
+    bsp::UART_TX_RESULT send_package(const uint8_t CMD, const uint8_t* data = nullptr,
+                                     uint16_t length = 0) {
+        TOOL_PROFILE_ZONE("finger::send_package");
         // if (waiting_ack_cmd_ != 0)
         //     return;
 
-        waiting_ack_cmd_ = CMD;
-
         finger_CMD_package package;
         package.header.length = sizeof(package.header.CMD) + length + sizeof(be_uint16_t);
         package.header.CMD    = CMD;
@@ -231,9 +284,12 @@ private:
         uint8_t watch[128] = {};
         std::memcpy(watch, &package, sizeof(package.header) + length + sizeof(checksum_));
 
-        uart_.Send(
-            reinterpret_cast<uint8_t*>(&package),
-            sizeof(package.header) + length + sizeof(checksum_), bsp::UART_TRANSFER_MODE::DMA);
+        auto result = uart_.Submit(
+            reinterpret_cast<uint8_t*>(&package), sizeof(package.header) + length + sizeof(checksum_));
+        if (result == bsp::UART_TX_RESULT::OK) {
+            waiting_ack_cmd_ = CMD;
+        }
+        return result;
     }
     static uint16_t checksum(const uint8_t* data, uint16_t length) {
         constexpr uint8_t checksum_offset =
@@ -247,14 +303,8 @@ private:
         return static_cast<uint16_t>(sum);
     }
     void identify_IT_set() { waiting_identify_ = true; }
-    void decode_IT_set() {
-        waiting_decode_ = true;
-        size_           = uart_.GetTrueRxSize();
-        if (is_enrolling_) {
-            this->decode();
-            waiting_decode_ = false;
-        }
-    }
+    // 接收环只能由主循环读取,中断中仅置位,注册期间主循环不再阻塞,无需在中断中解码
+    void decode_IT_set() { waiting_decode_ = true; }
 
     void set_LED_states() {
         static bool waiting_set_to_normal = false;
@@ -293,12 +343,83 @@ private:
         }
         };
         LED_state_ = LED_states::waiting;
-        LED_daemon_.SetDt(2);
+        LED_daemon_.SetDt(2s);
         if (waiting_set_to_normal) {
-            LED_daemon_.SetDt(0.8);
+            LED_daemon_.SetDt(800ms);
             waiting_set_to_normal = false;
         }
     }
+    tool::coro::task enroll_flow(finger_auto_enroll_params data) {
+        LED_daemon_.Pause();
+        enroll_params_ = data;
+        co_await tool::coro::delay(3500ms);
+        app::can_comm_instance->send_request(request::enroll_prompt);
+        co_await tool::coro::delay(1500ms);
+
+        enroll_params_.ID   = ++user_count_;
+        enroll_times_count_ = enroll_params_.times;
+        enroll_success_     = false;
+        is_enrolling_       = true;
+        enroll_preparing_   = false;
+        app::can_comm_instance->lock_rx_data();
+        this->LED_control(finger_led_params().set_mode(LED_modes::AlwaysOff));
+        co_await tool::coro::delay(50ms);
+
+        // 之后的应答由decode处理,超时由enroll_daemon_兜底
+        enroll_daemon_.StartOnce(20s);
+        this->send_package(
+            0x31, reinterpret_cast<uint8_t*>(&enroll_params_), sizeof(enroll_params_));
+    }
+    // 等待握手或写寄存器的应答
+    auto link_reply() {
+        return tool::coro::wait([this] { return link_ack_; }, 300ms);
+    }
+    // 发送队列清空后才能切换速率
+    auto switch_baud(uint32_t baud_rate) {
+        return tool::coro::wait([this, baud_rate] { return uart_.SetBaudRate(baud_rate); }, 200ms);
+    }
+    tool::coro::task link_flow() {
+        LED_daemon_.Pause();
+        const uint32_t safe   = baud_policy_.safe;
+        const uint32_t target = baud_policy_.target;
+        uint32_t linked       = 0;
+        // 写入的速率会保存在模组中,上电后依次在出厂速率和目标速率下握手
+        for (uint32_t baud_rate : {safe, target}) {
+            if (!co_await switch_baud(baud_rate)) {
+                continue; // 本地未能切换,该速率下握手没有意义
+            }
+            this->handshake();
+            if (co_await link_reply()) {
+                linked = baud_rate;
+                break;
+            }
+        }
+        if (linked == safe && target != safe) {
+            this->set_baud_rate(target);
+            if (co_await link_reply()) {
+                // 模组应答后已按新速率运行并保存,先在新速率下重试,都失败才退回出厂速率
+                linked = 0;
+                for (int attempt = 0; attempt < 3 && linked == 0; ++attempt) {
+                    if (!co_await switch_baud(target)) {
+                        continue;
+                    }
+                    co_await tool::coro::delay(50ms);
+                    this->handshake();
+                    linked = co_await link_reply() ? target : 0;
+                }
+                if (linked == 0 && co_await switch_baud(safe)) {
+                    this->handshake();
+                    linked = co_await link_reply() ? safe : 0;
+                }
+            }
+        }
+        if (linked == 0) {
+            co_await switch_baud(safe);
+        }
+        link_negotiating_ = false;
+        LED_daemon_.Resume();
+        this->get_user_count();
+    }
     void enroll_fallback() {
         is_enrolling_ = false;
         app::can_comm_instance->unlock_rx_data();
@@ -311,6 +432,7 @@ private:
     void allow_verify() { allow_verify_ = true; }
     bsp::uart<finger> uart_;
     bsp::gpio<finger> gpio_;
+    bsp::uart_baud_policy baud_policy_;
     tool::daemon<finger> LED_daemon_;
     tool::daemon<finger> EXTI_daemon_;
     tool::daemon<finger> enroll_daemon_;
@@ -319,7 +441,14 @@ private:
     uint8_t waiting_ack_cmd_ = 0;
     uint8_t user_count_      = 0;
 
+    bool link_negotiating_ = false;
+    bool link_ack_         = false;
+
+    finger_auto_enroll_params enroll_params_ = {};
+    tool::timeout notice_timeout_;
+
     uint8_t enroll_times_count_ = 0;
+    bool enroll_preparing_      = false;
     bool is_enrolling_          = false;
     bool enroll_success_        = false;
 
@@ -328,9 +457,6 @@ private:
     bool waiting_identify_ = false;
     bool waiting_decode_   = false;
 
-    uint16_t size_                = 0;
-    finger_ACK_package rx_package = {};
-
     LED_states LED_state_ = LED_states::waiting;
     enum class LED_time : uint8_t {
         day,
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "tool/endian_promise.hpp"
+#include "tool/frame_view.hpp"
 
 #include <cstdint>
 #include <cstring>
@@ -85,7 +86,39 @@ struct __attribute__((packed)) finger_ACK_package {
     } header;
     finger_status status;
     uint8_t data[128] = {};      // 末尾加上校验和
-    void set_zero() { std::memset(this, 0, sizeof(finger_ACK_package)); }
+};
+// 应答包的零拷贝视图,字段按协议偏移直接从接收环读取,布局与finger_ACK_package一致
+class finger_ACK_view {
+public:
+    static constexpr size_t HEADER_SIZE = sizeof(finger_ACK_package::header);
+    static constexpr size_t DATA_OFFSET = HEADER_SIZE + sizeof(finger_ACK_package::status);
+
+    constexpr explicit finger_ACK_view(frame_view frame)
+        : frame_(frame) {}
+
+    [[nodiscard]] constexpr uint16_t SOF() const { return frame_.BE16(0); }
+    [[nodiscard]] constexpr uint32_t address() const { return frame_.BE32(2); }
+    [[nodiscard]] constexpr uint8_t ID() const { return frame_.At(6); }
+    [[nodiscard]] constexpr uint16_t length() const { return frame_.BE16(7); }
+    [[nodiscard]] constexpr finger_status status() const {
+        return static_cast<finger_status>(frame_.At(HEADER_SIZE));
+    }
+    [[nodiscard]] constexpr uint8_t data(size_t index) const {
+        return frame_.At(DATA_OFFSET + index);
+    }
+    [[nodiscard]] constexpr uint16_t checksum() const { return frame_.BE16(frame_.Size() - 2); }
+    [[nodiscard]] constexpr size_t size() const { return frame_.Size(); }
+    // 校验和覆盖包标识到校验和之前的所有字节
+    [[nodiscard]] constexpr uint16_t calculate_checksum() const {
+        uint16_t sum = 0;
+        for (size_t i = 6; i + 2 < frame_.Size(); ++i) {
+            sum = static_cast<uint16_t>(sum + frame_.At(i));
+        }
+        return sum;
+    }
+
+private:
+    frame_view frame_;
 };
 
 enum class LED_modes : uint8_t {
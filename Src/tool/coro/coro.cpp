@@ -0,0 +1,118 @@
+#include "coro.hpp"
+
+#include <stm32f1xx.h>
+
+namespace tool::coro {
+
+alignas(std::max_align_t) uint8_t arena::storage_[arena::FRAME_COUNT][arena::FRAME_SIZE] = {};
+uint32_t arena::used_mask_                                                             = 0;
+
+task::handle_type executor::tasks_[executor::MAX_TASKS] = {};
+coro_stats executor::stats_                             = {0, 0, 0, 0, 0, UINT32_MAX, 0, 0};
+uint32_t executor::resume_start_                        = 0;
+bool executor::resuming_                                = false;
+
+void* arena::Allocate(size_t size) {
+    auto& stats = executor::stats_;
+    if (size > stats.frame_max_bytes) {
+        stats.frame_max_bytes = size;
+    }
+    if (size <= FRAME_SIZE) {
+        for (size_t i = 0; i < FRAME_COUNT; ++i) {
+            if ((used_mask_ & (1U << i)) == 0) {
+                used_mask_ |= 1U << i;
+                if (++stats.frames_in_use > stats.frames_peak) {
+                    stats.frames_peak = stats.frames_in_use;
+                }
+                return storage_[i];
+            }
+        }
+    }
+    ++stats.alloc_failures;
+    return nullptr;
+}
+
+void arena::Free(void* frame) {
+    auto index = static_cast<size_t>(static_cast<uint8_t*>(frame) - storage_[0]) / FRAME_SIZE;
+    if (index < FRAME_COUNT && (used_mask_ & (1U << index)) != 0) {
+        used_mask_ &= ~(1U << index);
+        --executor::stats_.frames_in_use;
+    }
+}
+
+void awaiter::mark_resumed() {
+    if (!executor::resuming_) {
+        return;
+    }
+    executor::resuming_ = false;
+    uint32_t cycles     = DWT->CYCCNT - executor::resume_start_;
+    auto& stats         = executor::stats_;
+    if (cycles < stats.switch_min) {
+        stats.switch_min = cycles;
+    }
+    if (cycles > stats.switch_max) {
+        stats.switch_max = cycles;
+    }
+}
+
+bool executor::Spawn(task&& t) {
+    if (!t) {
+        return false;
+    }
+    for (auto& slot : tasks_) {
+        if (!slot) {
+            slot = std::exchange(t.handle_, {});
+            return true;
+        }
+    }
+    return false;
+}
+
+void executor::Poll() {
+    for (auto& handle : tasks_) {
+        if (!handle) {
+            continue;
+        }
+        auto& promise = handle.promise();
+        if (promise.waiting_ != nullptr && !promise.waiting_->Ready()) {
+            continue;
+        }
+        promise.waiting_ = nullptr;
+
+        ++stats_.resume_count;
+        resuming_     = true;
+        resume_start_ = DWT->CYCCNT;
+        handle.resume();
+        uint32_t cycles = DWT->CYCCNT - resume_start_;
+        resuming_       = false;
+        if (cycles > stats_.step_max) {
+            stats_.step_max = cycles;
+        }
+
+        if (handle.done()) {
+            handle.destroy();
+            handle = {};
+        }
+    }
+}
+
+size_t executor::GetTaskCount() {
+    size_t count = 0;
+    for (auto& handle : tasks_) {
+        if (handle) {
+            ++count;
+        }
+    }
+    return count;
+}
+
+void executor::ResetStats() {
+    stats_.frames_peak    = stats_.frames_in_use;
+    stats_.alloc_failures = 0;
+    stats_.resume_count   = 0;
+    stats_.switch_min     = UINT32_MAX;
+    stats_.switch_max     = 0;
+    stats_.step_max       = 0;
+}
+
+} // namespace tool::coro
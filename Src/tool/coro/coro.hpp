@@ -0,0 +1,208 @@
+#pragma once
+
+#include "bsp/dwt/dwt.h"
+#include "tool/deadline.hpp"
+#include "tool/deamon/daemon.hpp"
+
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+/**
+ * 无堆协程执行器: 协程帧从静态槽位池分配,挂起时登记等待条件,由主循环调用executor::Poll()
+ * 轮询条件并恢复执行,用于把注册等长流程写成顺序代码而不阻塞主循环;只能在主循环中使用
+ */
+
+namespace tool::coro {
+
+struct coro_stats {
+    size_t frames_in_use;
+    size_t frames_peak;
+    size_t frame_max_bytes; // 实际申请过的最大帧,用于调整arena::FRAME_SIZE
+    uint32_t alloc_failures;
+    uint32_t resume_count;
+    uint32_t switch_min;    // executor调用resume到协程从co_await返回的周期数
+    uint32_t switch_max;
+    uint32_t step_max;      // 单次resume到再次挂起的周期数,包含协程体本身
+};
+
+// 固定大小的帧槽位,帧大于FRAME_SIZE或槽位用尽时分配失败
+class arena {
+public:
+    static constexpr size_t FRAME_SIZE  = 256;
+    static constexpr size_t FRAME_COUNT = 4;
+    static_assert(FRAME_COUNT <= 32);
+
+    static void* Allocate(size_t size);
+    static void Free(void* frame);
+
+private:
+    alignas(std::max_align_t) static uint8_t storage_[FRAME_COUNT][FRAME_SIZE];
+    static uint32_t used_mask_;
+};
+
+// 等待条件基类,派生类实现Ready(),挂起期间对象位于协程帧内
+class awaiter {
+public:
+    bool await_ready() { return Ready(); }
+    template <typename Promise>
+    void await_suspend(std::coroutine_handle<Promise> handle) {
+        handle.promise().waiting_ = this;
+    }
+
+    virtual bool Ready() = 0;
+
+protected:
+    ~awaiter() = default;
+    // 在await_resume中调用,统计切换开销
+    static void mark_resumed();
+};
+
+class task {
+public:
+    struct promise_type {
+        awaiter* waiting_ = nullptr;
+
+        static void* operator new(size_t size) noexcept { return arena::Allocate(size); }
+        static void operator delete(void* frame) noexcept { arena::Free(frame); }
+        static task get_return_object_on_allocation_failure() noexcept { return task{}; }
+
+        task get_return_object() {
+            return task{std::coroutine_handle<promise_type>::from_promise(*this)};
+        }
+        // 创建后先挂起,由executor在下一次Poll中开始执行
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        std::suspend_always final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() {}
+    };
+    using handle_type = std::coroutine_handle<promise_type>;
+
+    task() = default;
+    explicit task(handle_type handle)
+        : handle_(handle) {}
+    task(task&& other) noexcept
+        : handle_(std::exchange(other.handle_, {})) {}
+    task(const task&)            = delete;
+    task& operator=(const task&) = delete;
+    task& operator=(task&&)      = delete;
+    ~task() {
+        if (handle_) {
+            handle_.destroy();
+        }
+    }
+
+    // 帧分配失败时为false
+    [[nodiscard]] explicit operator bool() const { return static_cast<bool>(handle_); }
+
+private:
+    handle_type handle_ = {};
+    friend class executor;
+};
+
+class executor {
+public:
+    static constexpr size_t MAX_TASKS = arena::FRAME_COUNT;
+
+    // 接管协程,帧分配失败或任务表满时返回false
+    static bool Spawn(task&& t);
+    // 在主循环中调用,恢复所有等待条件已满足的协程
+    static void Poll();
+
+    [[nodiscard]] static size_t GetTaskCount();
+    [[nodiscard]] static const coro_stats& GetStats() { return stats_; }
+    static void ResetStats();
+
+private:
+    static task::handle_type tasks_[MAX_TASKS];
+    static coro_stats stats_;
+    static uint32_t resume_start_;
+    static bool resuming_;
+
+    friend class arena;
+    friend class awaiter;
+};
+
+// 等待一段时间
+class delay : public awaiter {
+public:
+    explicit delay(deadline::clock::duration duration)
+        : deadline_(deadline::After(duration)) {}
+
+    bool Ready() override {
+        if (deadline_.IsExpired()) {
+            return true;
+        }
+        daemon_base::RequestWakeup(deadline_.At());
+        return false;
+    }
+    void await_resume() const { mark_resumed(); }
+
+private:
+    deadline deadline_;
+};
+
+// 等待条件成立,例如串口应答标志;超时返回false
+template <typename Predicate>
+class wait : public awaiter {
+public:
+    wait(Predicate predicate, deadline::clock::duration timeout)
+        : predicate_(std::move(predicate))
+        , deadline_(deadline::After(timeout)) {}
+
+    bool Ready() override {
+        if (predicate_()) {
+            satisfied_ = true;
+            return true;
+        }
+        if (deadline_.IsExpired()) {
+            return true;
+        }
+        daemon_base::RequestWakeup(deadline_.At());
+        return false;
+    }
+    bool await_resume() const {
+        mark_resumed();
+        return satisfied_;
+    }
+
+private:
+    Predicate predicate_;
+    deadline deadline_;
+    bool satisfied_ = false;
+};
+
+// 等待getter的返回值相对co_await时发生变化,例如CAN下发的状态标志;超时返回false
+template <typename Getter>
+class changed : public awaiter {
+public:
+    changed(Getter getter, deadline::clock::duration timeout)
+        : getter_(std::move(getter))
+        , initial_(getter_())
+        , deadline_(deadline::After(timeout)) {}
+
+    bool Ready() override {
+        if (getter_() != initial_) {
+            satisfied_ = true;
+            return true;
+        }
+        if (deadline_.IsExpired()) {
+            return true;
+        }
+        daemon_base::RequestWakeup(deadline_.At());
+        return false;
+    }
+    bool await_resume() const {
+        mark_resumed();
+        return satisfied_;
+    }
+
+private:
+    Getter getter_;
+    decltype(getter_()) initial_;
+    deadline deadline_;
+    bool satisfied_ = false;
+};
+
+} // namespace tool::coro
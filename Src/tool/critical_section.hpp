@@ -0,0 +1,25 @@
+#pragma once
+
+#include <stm32f1xx.h>
+
+#include <cstdint>
+
+namespace tool {
+
+// 作用域内关闭中断,析构时恢复进入前的PRIMASK,可嵌套使用
+class critical_section {
+public:
+    critical_section()
+        : primask_(__get_PRIMASK()) {
+        __disable_irq();
+    }
+    ~critical_section() { __set_PRIMASK(primask_); }
+
+    critical_section(const critical_section&)            = delete;
+    critical_section& operator=(const critical_section&) = delete;
+
+private:
+    uint32_t primask_;
+};
+
+} // namespace tool
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "bsp/dwt/dwt.h"
+#include "tool/critical_section.hpp"
+#include "tool/deamon/daemon.hpp"
+
+namespace tool {
+
+// 基于DWT时间轴的绝对截止时间,值类型,只在单一上下文中使用
+class deadline {
+public:
+    using clock = bsp::dwt::clock;
+
+    constexpr deadline() = default;
+    constexpr explicit deadline(clock::time_point at)
+        : at_(at) {}
+
+    [[nodiscard]] static deadline After(clock::duration duration) {
+        return deadline(clock::now() + duration);
+    }
+
+    [[nodiscard]] bool IsExpired() const { return clock::now() >= at_; }
+    [[nodiscard]] clock::duration Remaining() const {
+        auto now = clock::now();
+        return now >= at_ ? clock::duration::zero() : at_ - now;
+    }
+    [[nodiscard]] clock::time_point At() const { return at_; }
+
+private:
+    clock::time_point at_ = {};
+};
+
+/**
+ * @brief 可启停的一次性超时,用于在主循环中以非阻塞方式替代DWT_Delay
+ * @note Start/Stop可在中断中调用,内部以临界区保护64位截止时间
+ * @note 运行期间每次轮询都会向守护调度器登记唤醒请求,保证主循环睡眠时仍能按时检查
+ */
+class timeout {
+public:
+    using clock = bsp::dwt::clock;
+
+    void Start(clock::duration duration) {
+        auto at = deadline::After(duration);
+        {
+            critical_section cs;
+            deadline_ = at;
+            running_  = true;
+        }
+        daemon_base::RequestWakeup(at.At());
+    }
+    void Stop() { running_ = false; }
+    [[nodiscard]] bool IsRunning() const { return running_; }
+
+    // 超时到达时返回一次true,随后自动停止
+    [[nodiscard]] bool Expired() {
+        critical_section cs;
+        if (!running_) {
+            return false;
+        }
+        if (deadline_.IsExpired()) {
+            running_ = false;
+            return true;
+        }
+        daemon_base::RequestWakeup(deadline_.At());
+        return false;
+    }
+
+private:
+    deadline deadline_     = {};
+    volatile bool running_ = false;
+};
+
+} // namespace tool
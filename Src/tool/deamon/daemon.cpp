@@ -1,23 +1,267 @@
 #include "daemon.hpp"
 #include "bsp/dwt/dwt.h"
+#include "bsp/sleep/sleep.hpp"
+#include "tool/profile/profile.hpp"
 
 namespace tool {
 daemon_base* daemon_base::daemon_instances_[daemon_base::MAX_DAEMON_INSTANCES] = {nullptr};
 uint8_t daemon_base::daemon_instance_count_                                    = 0;
-} // namespace tool
+daemon_base* daemon_base::deadline_heap_[daemon_base::MAX_DAEMON_INSTANCES]    = {nullptr};
+uint8_t daemon_base::deadline_heap_size_                                       = 0;
+daemon_base* daemon_base::ready_queue_[daemon_base::READY_QUEUE_SIZE]          = {nullptr};
+std::atomic<uint8_t> daemon_base::ready_head_                                  = 0;
+std::atomic<uint8_t> daemon_base::ready_tail_                                  = 0;
+bool daemon_base::started_                                                     = false;
+bool daemon_base::wakeup_pending_                                              = false;
+daemon_base::clock::time_point daemon_base::wakeup_at_                         = {};
+
+void daemon_base::Begin() {
+    HAL_TIM_Base_Start(&htim4);
+    critical_section cs;
+    started_ = true;
+    arm();
+    // 比较中断此后一直开启,没有截止时间时由arm装载保活比较
+    htim4.Instance->DIER = htim4.Instance->DIER | TIM_IT_CC1;
+}
+
+void daemon_base::RequestWakeup(clock::time_point at) {
+    critical_section cs;
+    if (!wakeup_pending_ || at < wakeup_at_) {
+        wakeup_at_      = at;
+        wakeup_pending_ = true;
+        arm();
+    }
+}
+
+void daemon_base::arm() {
+    if (!started_) {
+        return;
+    }
+    // 无任何定时时也按最长间隔(约60ms)装载: 睡眠期间SysTick暂停,由这个空转的比较中断在tick中
+    // 读取CYCCNT,保证两次读取间隔远小于半周期(约29.8s),维持DWT的64位扩展
+    clock::time_point next =
+        deadline_heap_size_ > 0 ? deadline_heap_[0]->deadline_ : clock::time_point::max();
+    if (wakeup_pending_ && wakeup_at_ < next) {
+        next = wakeup_at_;
+    }
+
+    auto now       = clock::now();
+    uint32_t ticks = 0;
+    if (next > now) {
+        auto delta = static_cast<uint64_t>((next - now).count());
+        // 向上取整到1us,再多加1个计数以抵消预分频相位,保证比较触发时截止时间已过
+        ticks = delta >= uint64_t{MAX_ARM_TICKS} * CYCLES_PER_TICK
+                    ? MAX_ARM_TICKS
+                    : static_cast<uint32_t>(delta) / CYCLES_PER_TICK + 2;
+    }
+
+    htim4.Instance->SR = static_cast<uint32_t>(~TIM_SR_CC1IF);
+    bool force = ticks == 0;
+    if (!force) {
+        auto start = static_cast<uint16_t>(__HAL_TIM_GET_COUNTER(&htim4));
+        __HAL_TIM_SET_COMPARE(&htim4, TIM_CHANNEL_1, static_cast<uint16_t>(start + ticks));
+        // 写入前计数器若已越过比较值则要等一整圈,直接软件触发
+        force = static_cast<uint16_t>(__HAL_TIM_GET_COUNTER(&htim4) - start) >= ticks;
+    }
+    if (force) {
+        htim4.Instance->EGR = TIM_EGR_CC1G;
+    }
+}
+
+void daemon_base::reschedule(daemon_base* instance, clock::time_point deadline) {
+    if (instance->heap_index_ == NOT_SCHEDULED) {
+        if (deadline_heap_size_ >= MAX_DAEMON_INSTANCES) {
+            return;
+        }
+        instance->deadline_ = deadline;
+        place(instance, deadline_heap_size_++);
+        sift_up(instance->heap_index_);
+        return;
+    }
+    // 截止时间可能提前也可能推后,两个方向各尝试一次
+    bool earlier        = deadline < instance->deadline_;
+    instance->deadline_ = deadline;
+    if (earlier) {
+        sift_up(instance->heap_index_);
+    } else {
+        sift_down(instance->heap_index_);
+    }
+}
+
+void daemon_base::unschedule(daemon_base* instance) {
+    uint8_t index = instance->heap_index_;
+    if (index == NOT_SCHEDULED) {
+        return;
+    }
+    instance->heap_index_ = NOT_SCHEDULED;
+    auto last             = deadline_heap_[--deadline_heap_size_];
+    if (last == instance) {
+        return;
+    }
+    place(last, index);
+    sift_up(index);
+    sift_down(last->heap_index_);
+}
+
+void daemon_base::sift_up(uint8_t index) {
+    auto instance = deadline_heap_[index];
+    while (index > 0) {
+        uint8_t parent = (index - 1) / 2;
+        if (!(instance->deadline_ < deadline_heap_[parent]->deadline_)) {
+            break;
+        }
+        place(deadline_heap_[parent], index);
+        index = parent;
+    }
+    place(instance, index);
+}
+
+void daemon_base::sift_down(uint8_t index) {
+    auto instance = deadline_heap_[index];
+    for (;;) {
+        uint8_t child = 2 * index + 1;
+        if (child >= deadline_heap_size_) {
+            break;
+        }
+        if (child + 1 < deadline_heap_size_ &&
+            deadline_heap_[child + 1]->deadline_ < deadline_heap_[child]->deadline_) {
+            ++child;
+        }
+        if (!(deadline_heap_[child]->deadline_ < instance->deadline_)) {
+            break;
+        }
+        place(deadline_heap_[child], index);
+        index = child;
+    }
+    place(instance, index);
+}
 
-extern "C" void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef* htim) {
-    if (htim->Instance == TIM4) {
-
-        for (size_t i = 0; i < tool::daemon_base::daemon_instance_count_; ++i) {
-            float current_time = DWT_GetTimeline_s();
-            auto instance      = tool::daemon_base::daemon_instances_[i];
-            if (instance->state_ == tool::daemon_base::deamon_state::running) {
-                if (current_time - instance->last_reload_time_ > instance->dt_) {
-                    instance->OnCallback();
-                    instance->last_reload_time_ = current_time;
-                }
+void daemon_base::push_ready(daemon_base* instance) {
+    if (instance->queued_.load(std::memory_order_relaxed)) {
+        return;
+    }
+    uint8_t head = ready_head_.load(std::memory_order_relaxed);
+    if (static_cast<uint8_t>(head - ready_tail_.load(std::memory_order_acquire)) >=
+        READY_QUEUE_SIZE) {
+        return;
+    }
+    instance->queued_.store(true, std::memory_order_relaxed);
+    ready_queue_[head & (READY_QUEUE_SIZE - 1)] = instance;
+    ready_head_.store(head + 1, std::memory_order_release);
+}
+
+void daemon_base::RunDeferred() {
+    uint8_t tail = ready_tail_.load(std::memory_order_relaxed);
+    while (tail != ready_head_.load(std::memory_order_acquire)) {
+        auto instance = ready_queue_[tail & (READY_QUEUE_SIZE - 1)];
+        ready_tail_.store(++tail, std::memory_order_release);
+        // 先清除标志再执行,回调期间再次到期可重新入队;入队后被Pause的标志已清除,不再执行
+        if (instance->queued_.exchange(false, std::memory_order_relaxed)) {
+            instance->run_callback();
+        }
+    }
+}
+
+void daemon_base::run_callback() {
+#if TOOL_DAEMON_STATS_ENABLED
+    auto lateness  = static_cast<uint64_t>((clock::now() - expected_).count());
+    auto late      = lateness > UINT32_MAX ? UINT32_MAX : static_cast<uint32_t>(lateness);
+    uint32_t start = DWT->CYCCNT;
+    OnCallback();
+    uint32_t cycles = DWT->CYCCNT - start;
+
+    ++stats_.fire_count;
+    if (late < stats_.lateness_min) {
+        stats_.lateness_min = late;
+    }
+    if (late > stats_.lateness_max) {
+        stats_.lateness_max = late;
+    }
+    // 单次定时触发后已处于暂停态,不计错过的周期
+    auto period = static_cast<uint64_t>(dt_.count());
+    if (!IsPaused() && period != 0) {
+        stats_.missed_periods += static_cast<uint32_t>(lateness / period);
+    }
+    if (cycles > stats_.callback_max) {
+        stats_.callback_max = cycles;
+    }
+#else
+    OnCallback();
+#endif
+}
+
+#if TOOL_DAEMON_STATS_ENABLED
+void daemon_base::ResetStats() {
+    critical_section cs;
+    for (uint8_t i = 0; i < daemon_instance_count_; ++i) {
+        auto& stats        = daemon_instances_[i]->stats_;
+        auto name          = stats.name;
+        stats              = {};
+        stats.name         = name;
+        stats.lateness_min = UINT32_MAX;
+    }
+}
+#endif
+
+bool daemon_base::tick() {
+    auto current_time = clock::now();
+    bool notify       = false;
+    {
+        critical_section cs;
+        if (wakeup_pending_ && !(current_time < wakeup_at_)) {
+            wakeup_pending_ = false;
+            notify          = true;
+        }
+    }
+    for (;;) {
+        daemon_base* instance;
+        {
+            // 更高优先级中断(串口/外部中断)可能在回调期间Pause/Resume守护,堆操作须关中断
+            critical_section cs;
+            if (deadline_heap_size_ == 0 || !(deadline_heap_[0]->deadline_ < current_time)) {
+                break;
             }
+            instance = deadline_heap_[0];
+            unschedule(instance);
+            instance->last_reload_time_ = current_time;
+#if TOOL_DAEMON_STATS_ENABLED
+            instance->expected_ = instance->deadline_;
+#endif
+            if (instance->oneshot_) {
+                instance->oneshot_ = false;
+                instance->state_   = deamon_state::paused;
+            }
+        }
+        notify = true;
+
+        if (instance->mode_ == mode::deferred) {
+            push_ready(instance);
+        } else {
+            instance->run_callback();
+        }
+
+        {
+            // 回调中若已Pause则不再入堆;若已Reload/SetDt则已按新截止时间入堆
+            critical_section cs;
+            if (instance->state_ == deamon_state::running &&
+                instance->heap_index_ == NOT_SCHEDULED) {
+                reschedule(instance, instance->last_reload_time_ + instance->dt_);
+            }
+        }
+    }
+    critical_section cs;
+    arm();
+    return notify;
+}
+} // namespace tool
+
+extern "C" void HAL_TIM_OC_DelayElapsedCallback(TIM_HandleTypeDef* htim) {
+    if (htim->Instance == TIM4 && htim->Channel == HAL_TIM_ACTIVE_CHANNEL_1) {
+        TOOL_PROFILE_ZONE("daemon::tick");
+
+        // 仅在有守护到期或超时唤醒请求到达时唤醒主循环
+        if (tool::daemon_base::tick()) {
+            bsp::sleep::Notify();
         }
     }
-}
\ No newline at end of file
+}
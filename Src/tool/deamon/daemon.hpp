@@ -1,13 +1,37 @@
 #pragma once
 #include "bsp/dwt/dwt.h"
+#include "tool/critical_section.hpp"
 
 #include <tim.h>
 
+#include <atomic>
 #include <cstddef>
 #include <cstdint>
 
+/**
+ * 守护运行统计(迟到、错过的周期数、回调耗时),默认在debug下启用,release(NDEBUG)下不编译;
+ * 也可以通过-DTOOL_DAEMON_STATS_ENABLED=0/1强制关闭/开启
+ */
+#ifndef TOOL_DAEMON_STATS_ENABLED
+# ifdef NDEBUG
+#  define TOOL_DAEMON_STATS_ENABLED 0
+# else
+#  define TOOL_DAEMON_STATS_ENABLED 1
+# endif
+#endif
+
 namespace tool {
 
+// 时间单位均为CPU周期;迟到为回调开始执行时刻相对截止时间的差值,deferred守护包含主循环的调度延迟
+struct daemon_stats {
+    const char* name;
+    uint32_t fire_count;
+    uint32_t lateness_min;
+    uint32_t lateness_max;
+    uint32_t missed_periods;
+    uint32_t callback_max;
+};
+
 class daemon_base {
     enum class deamon_state : uint8_t {
         running,
@@ -15,26 +39,103 @@ class daemon_base {
     };
 
 public:
-    virtual ~daemon_base() { unregister_instance(this); }
+    using clock = bsp::dwt::clock;
+
+    // immediate: 回调直接在TIM4中断中执行; deferred: 中断只将其放入就绪队列,由主循环执行
+    enum class mode : uint8_t {
+        immediate,
+        deferred,
+    };
+
+    virtual ~daemon_base() {
+        {
+            critical_section cs;
+            unschedule(this);
+            arm();
+        }
+        unregister_instance(this);
+    }
     virtual void OnCallback() = 0;
 
-    void SetDt(float dt) { dt_ = dt; }
-    void Reload() { last_reload_time_ = DWT_GetTimeline_s(); }
-    void Pause() { state_ = deamon_state::paused; }
+    // 64位时间在M3上需两次写入,且堆可能被TIM4中断同时修改,均在临界区内完成
+    void SetDt(clock::duration dt) {
+        critical_section cs;
+        dt_ = dt;
+        if (state_ == deamon_state::running) {
+            reschedule(this, last_reload_time_ + dt_);
+            arm();
+        }
+    }
+    void Reload() {
+        auto now = clock::now();
+        critical_section cs;
+        last_reload_time_ = now;
+        if (state_ == deamon_state::running) {
+            reschedule(this, now + dt_);
+            arm();
+        }
+    }
+    void Pause() {
+        critical_section cs;
+        state_   = deamon_state::paused;
+        oneshot_ = false;
+        queued_.store(false, std::memory_order_relaxed);
+        unschedule(this);
+        arm();
+    }
     void Resume() {
-        state_ = deamon_state::running;
+        {
+            critical_section cs;
+            state_   = deamon_state::running;
+            oneshot_ = false;
+        }
         Reload();
     }
+    // 单次定时: delay后执行一次回调,随后自动进入暂停态
+    void StartOnce(clock::duration delay) {
+        auto now = clock::now();
+        critical_section cs;
+        dt_               = delay;
+        oneshot_          = true;
+        state_            = deamon_state::running;
+        last_reload_time_ = now;
+        reschedule(this, now + delay);
+        arm();
+    }
     [[nodiscard]] bool IsPaused() const { return state_ == deamon_state::paused; }
 
-protected:
-    float dt_;
-    float last_reload_time_ = 0;
-    deamon_state state_     = deamon_state::running;
+    // 启动TIM4计数并按最早的截止时间装载比较通道,需在DWT_Init之后调用
+    static void Begin();
+    // 在主循环中调用,执行所有已到期的deferred守护回调
+    static void RunDeferred();
+    // 请求在at时刻唤醒主循环一次,供tool::timeout等轮询式超时使用,仅保留最早的请求
+    static void RequestWakeup(clock::time_point at);
+
+#if TOOL_DAEMON_STATS_ENABLED
+    [[nodiscard]] static size_t GetStatsCount() { return daemon_instance_count_; }
+    [[nodiscard]] static const daemon_stats* GetStats(size_t index) {
+        return index < daemon_instance_count_ ? &daemon_instances_[index]->stats_ : nullptr;
+    }
+    static void ResetStats();
+#endif
 
-    explicit daemon_base(float dt)
-        : dt_(dt) {
+protected:
+    clock::duration dt_;
+    clock::time_point last_reload_time_ = {};
+    deamon_state state_                 = deamon_state::running;
+    mode mode_;
+
+    explicit daemon_base(clock::duration dt, mode m, [[maybe_unused]] const char* name)
+        : dt_(dt)
+        , mode_(m) {
+#if TOOL_DAEMON_STATS_ENABLED
+        stats_.name         = name;
+        stats_.lateness_min = UINT32_MAX;
+#endif
         register_instance(this);
+        critical_section cs;
+        reschedule(this, last_reload_time_ + dt_);
+        arm();
     }
 
     static void unregister_instance(daemon_base* instance) {
@@ -58,10 +159,64 @@ protected:
 
 private:
     static constexpr size_t MAX_DAEMON_INSTANCES = 25;
+    static constexpr uint8_t NOT_SCHEDULED       = 0xFF;
+    static_assert(MAX_DAEMON_INSTANCES < NOT_SCHEDULED);
+
     static daemon_base* daemon_instances_[MAX_DAEMON_INSTANCES];
     static uint8_t daemon_instance_count_;
 
-    friend void ::HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef* htim);
+    // 按截止时间排序的最小堆,仅包含处于运行态的守护,堆顶即最早到期者
+    static daemon_base* deadline_heap_[MAX_DAEMON_INSTANCES];
+    static uint8_t deadline_heap_size_;
+
+    clock::time_point deadline_ = {};
+    uint8_t heap_index_         = NOT_SCHEDULED;
+
+    // TIM4中断为唯一生产者,主循环为唯一消费者的无锁就绪队列
+    static constexpr uint8_t READY_QUEUE_SIZE = 32;
+    static_assert((READY_QUEUE_SIZE & (READY_QUEUE_SIZE - 1)) == 0);
+    static_assert(READY_QUEUE_SIZE > MAX_DAEMON_INSTANCES);
+    static daemon_base* ready_queue_[READY_QUEUE_SIZE];
+    static std::atomic<uint8_t> ready_head_;
+    static std::atomic<uint8_t> ready_tail_;
+
+    // 已在就绪队列中尚未执行,防止重复入队;Pause时清除以取消尚未执行的回调
+    std::atomic<bool> queued_ = false;
+    bool oneshot_             = false;
+
+    // TIM4以1MHz自由计数,CC1按最早截止时间比较;16位计数器单次最多装载约60ms
+    static constexpr uint32_t CYCLES_PER_TICK = bsp::dwt::cpu_freq_hz / 1000000U;
+    static constexpr uint32_t MAX_ARM_TICKS   = 60000;
+    static bool started_;
+    static bool wakeup_pending_;
+    static clock::time_point wakeup_at_;
+
+#if TOOL_DAEMON_STATS_ENABLED
+    daemon_stats stats_         = {};
+    clock::time_point expected_ = {};
+#endif
+
+    // 执行回调,启用统计时记录迟到与耗时
+    void run_callback();
+
+    static void push_ready(daemon_base* instance);
+
+    // 以下堆操作均要求调用者已关中断
+    static void reschedule(daemon_base* instance, clock::time_point deadline);
+    static void unschedule(daemon_base* instance);
+    static void sift_up(uint8_t index);
+    static void sift_down(uint8_t index);
+    static void place(daemon_base* instance, uint8_t index) {
+        deadline_heap_[index] = instance;
+        instance->heap_index_ = index;
+    }
+    // 按堆顶与唤醒请求中较早者装载CC1,两者皆无时关闭比较中断
+    static void arm();
+
+    // TIM4比较中断中调用: 依次弹出所有已到期的守护并执行回调,返回是否有事件需通知主循环
+    static bool tick();
+
+    friend void ::HAL_TIM_OC_DelayElapsedCallback(TIM_HandleTypeDef* htim);
 };
 
 template <typename Derived>
@@ -69,8 +224,9 @@ class daemon : public daemon_base {
 public:
     using CallbackFunction = void (Derived::*)();
 
-    explicit daemon(const float dt, Derived* instance, CallbackFunction function)
-        : daemon_base(dt)
+    explicit daemon(const clock::duration dt, Derived* instance, CallbackFunction function,
+                    mode m = mode::immediate, const char* name = nullptr)
+        : daemon_base(dt, m, name)
         , callback_instance_(instance)
         , callback_function_(function) {}
 
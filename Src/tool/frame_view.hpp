@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace tool {
+
+/**
+ * @brief 指向接收环或线性缓冲区中一帧数据的只读视图,不复制也不清零
+ * @note 所有访问都做越界检查,越界读取返回0;环形缓冲区长度须为2的幂,跨越环尾的帧按下标自动回绕
+ */
+class frame_view {
+public:
+    constexpr frame_view() = default;
+    // 线性缓冲区
+    constexpr frame_view(const uint8_t* data, size_t size)
+        : base_(data)
+        , mask_(SIZE_MAX)
+        , size_(size) {}
+    // 环形缓冲区,start为帧首字节的自由递增下标
+    constexpr frame_view(const uint8_t* ring, size_t ring_size, size_t start, size_t size)
+        : base_(ring)
+        , mask_(ring_size - 1)
+        , start_(start & (ring_size - 1))
+        , size_(size) {}
+
+    [[nodiscard]] constexpr size_t Size() const { return size_; }
+    [[nodiscard]] constexpr bool Contains(size_t offset, size_t length) const {
+        return offset <= size_ && length <= size_ - offset;
+    }
+
+    [[nodiscard]] constexpr uint8_t At(size_t offset) const {
+        return offset < size_ ? base_[(start_ + offset) & mask_] : 0;
+    }
+    [[nodiscard]] constexpr uint8_t operator[](size_t offset) const { return At(offset); }
+
+    // 按字节拼接,与对齐和本机字节序无关
+    [[nodiscard]] constexpr uint16_t BE16(size_t offset) const {
+        return static_cast<uint16_t>(At(offset) << 8 | At(offset + 1));
+    }
+    [[nodiscard]] constexpr uint32_t BE32(size_t offset) const {
+        return static_cast<uint32_t>(BE16(offset)) << 16 | BE16(offset + 2);
+    }
+    [[nodiscard]] constexpr uint16_t LE16(size_t offset) const {
+        return static_cast<uint16_t>(At(offset) | At(offset + 1) << 8);
+    }
+
+    // 子视图,超出部分被截断
+    [[nodiscard]] constexpr frame_view Sub(size_t offset, size_t length) const {
+        if (offset > size_) {
+            offset = size_;
+        }
+        if (length > size_ - offset) {
+            length = size_ - offset;
+        }
+        frame_view view = *this;
+        view.start_     = (start_ + offset) & mask_;
+        view.size_      = length;
+        return view;
+    }
+
+    // 复制到连续内存,返回实际复制的字节数
+    size_t CopyTo(uint8_t* buffer, size_t length) const {
+        length = length < size_ ? length : size_;
+        for (size_t i = 0; i < length; ++i) {
+            buffer[i] = base_[(start_ + i) & mask_];
+        }
+        return length;
+    }
+
+private:
+    const uint8_t* base_ = nullptr;
+    size_t mask_         = 0;
+    size_t start_        = 0;
+    size_t size_         = 0;
+};
+
+} // namespace tool
@@ -0,0 +1,63 @@
+#include "profile.hpp"
+#include "tool/critical_section.hpp"
+
+#include <bit>
+#include <cstring>
+
+#if TOOL_PROFILE_ENABLED
+
+namespace tool {
+
+profile_stats profile::zones_[profile::MAX_ZONES] = {};
+size_t profile::zone_count_                       = 0;
+
+profile_stats* profile::Register(const char* name) {
+    critical_section cs;
+    for (size_t i = 0; i < zone_count_; ++i) {
+        if (std::strcmp(zones_[i].name, name) == 0) {
+            return &zones_[i];
+        }
+    }
+    if (zone_count_ >= MAX_ZONES) {
+        return nullptr;
+    }
+    auto& stats = zones_[zone_count_++];
+    stats       = {};
+    stats.name  = name;
+    stats.min   = UINT32_MAX;
+    return &stats;
+}
+
+void profile::Record(profile_stats* stats, uint32_t cycles) {
+    if (stats == nullptr) {
+        return;
+    }
+    auto& bucket = stats->histogram[std::bit_width(cycles)];
+
+    critical_section cs;
+    ++stats->count;
+    stats->sum += cycles;
+    if (cycles < stats->min) {
+        stats->min = cycles;
+    }
+    if (cycles > stats->max) {
+        stats->max = cycles;
+    }
+    if (bucket != UINT16_MAX) {
+        ++bucket;
+    }
+}
+
+void profile::Reset() {
+    critical_section cs;
+    for (size_t i = 0; i < zone_count_; ++i) {
+        auto name      = zones_[i].name;
+        zones_[i]      = {};
+        zones_[i].name = name;
+        zones_[i].min  = UINT32_MAX;
+    }
+}
+
+} // namespace tool
+
+#endif
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <stm32f1xx.h>
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * 代码段耗时统计,默认在debug下启用,release(NDEBUG)下TOOL_PROFILE_ZONE展开为空,
+ * 统计表和计时代码都不会进入固件;也可以通过-DTOOL_PROFILE_ENABLED=0/1强制关闭/开启
+ */
+#ifndef TOOL_PROFILE_ENABLED
+# ifdef NDEBUG
+#  define TOOL_PROFILE_ENABLED 0
+# else
+#  define TOOL_PROFILE_ENABLED 1
+# endif
+#endif
+
+namespace tool {
+
+struct profile_stats {
+    // 第i个桶统计耗时在[2^(i-1), 2^i)个周期内的次数,第0个桶为0周期,计数饱和于UINT16_MAX
+    static constexpr size_t HISTOGRAM_SIZE = 33;
+
+    const char* name;
+    uint32_t count;
+    uint32_t min;
+    uint32_t max;
+    uint64_t sum;
+    uint16_t histogram[HISTOGRAM_SIZE];
+};
+
+class profile {
+public:
+    static constexpr size_t MAX_ZONES = 12;
+
+    // 按名称注册统计项,同名返回已有项,表满时返回nullptr
+    static profile_stats* Register(const char* name);
+    static void Record(profile_stats* stats, uint32_t cycles);
+    static void Reset();
+
+    [[nodiscard]] static size_t GetZoneCount() { return zone_count_; }
+    [[nodiscard]] static const profile_stats* GetZone(size_t index) {
+        return index < zone_count_ ? &zones_[index] : nullptr;
+    }
+
+private:
+    static profile_stats zones_[MAX_ZONES];
+    static size_t zone_count_;
+};
+
+// RAII计时,构造到析构之间的CYCCNT差值计入对应统计项
+class profile_zone {
+public:
+    explicit profile_zone(profile_stats* stats)
+        : stats_(stats)
+        , start_(DWT->CYCCNT) {}
+    ~profile_zone() { profile::Record(stats_, DWT->CYCCNT - start_); }
+
+    profile_zone(const profile_zone&)            = delete;
+    profile_zone& operator=(const profile_zone&) = delete;
+
+private:
+    profile_stats* stats_;
+    uint32_t start_;
+};
+
+} // namespace tool
+
+#define TOOL_PROFILE_CONCAT_(a, b) a##b
+#define TOOL_PROFILE_CONCAT(a, b)  TOOL_PROFILE_CONCAT_(a, b)
+
+/**
+ * @brief 统计当前作用域剩余部分的耗时,例如 TOOL_PROFILE_ZONE("finger::decode");
+ */
+#if TOOL_PROFILE_ENABLED
+# define TOOL_PROFILE_ZONE(name)                                                       \
+     static tool::profile_stats* const TOOL_PROFILE_CONCAT(profile_stats_, __LINE__) = \
+         tool::profile::Register(name);                                                \
+     tool::profile_zone TOOL_PROFILE_CONCAT(profile_zone_, __LINE__)(                  \
+         TOOL_PROFILE_CONCAT(profile_stats_, __LINE__))
+#else
+# define TOOL_PROFILE_ZONE(name) static_cast<void>(0)
+#endif
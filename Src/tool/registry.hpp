@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+
+namespace tool {
+
+/**
+ * @brief 以小整数为键的实例表,键由各驱动从硬件信息直接得到(串口序号、EXTI线号、CAN过滤器匹配序号等),
+ *        中断中按下标取实例,无需遍历比较
+ * @tparam T 实例类型
+ * @tparam N 键的取值范围[0, N)
+ */
+template <typename T, size_t N>
+class registry {
+public:
+    static constexpr size_t CAPACITY = N;
+
+    // 键越界或已被占用时返回false
+    bool Register(size_t key, T* instance) {
+        if (key >= N || slots_[key] != nullptr) {
+            return false;
+        }
+        slots_[key] = instance;
+        ++count_;
+        return true;
+    }
+    void Unregister(T* instance) {
+        for (auto& slot : slots_) {
+            if (slot == instance) {
+                slot = nullptr;
+                --count_;
+            }
+        }
+    }
+
+    void Clear() {
+        for (auto& slot : slots_) {
+            slot = nullptr;
+        }
+        count_ = 0;
+    }
+
+    [[nodiscard]] T* Find(size_t key) const { return key < N ? slots_[key] : nullptr; }
+    [[nodiscard]] size_t GetCount() const { return count_; }
+
+    template <typename Function>
+    void ForEach(Function function) const {
+        for (auto slot : slots_) {
+            if (slot != nullptr) {
+                function(slot);
+            }
+        }
+    }
+
+private:
+    T* slots_[N]  = {};
+    size_t count_ = 0;
+};
+
+} // namespace tool
@@ -54,7 +54,8 @@ void MX_CAN_Init(void)
     Error_Handler();
   }
   /* USER CODE BEGIN CAN_Init 2 */
-
+  /* Power-on default only (125k, 50% sample point): can_base::SetBitrate() rewrites the bit
+     timing from can_timing.hpp before the first CAN instance starts */
   /* USER CODE END CAN_Init 2 */
 
 }
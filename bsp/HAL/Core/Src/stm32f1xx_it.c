@@ -22,6 +22,8 @@
 #include "stm32f1xx_it.h"
 /* Private includes ----------------------------------------------------------*/
 /* USER CODE BEGIN Includes */
+#include "bsp/fast_irq/fast_irq.h"
+#include "bsp/irq_trace/irq_trace.h"
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -214,11 +216,18 @@ void SysTick_Handler(void)
 void DMA1_Channel2_IRQHandler(void)
 {
   /* USER CODE BEGIN DMA1_Channel2_IRQn 0 */
-
+  IRQ_TRACE_ENTER(IRQ_TRACE_DMA1_CH2);
+#if BSP_FAST_IRQ_ENABLED
+  if (BSP_FastIRQ_UART_DMA(&hdma_usart3_tx))
+  {
+    IRQ_TRACE_EXIT(IRQ_TRACE_DMA1_CH2);
+    return;
+  }
+#endif
   /* USER CODE END DMA1_Channel2_IRQn 0 */
   HAL_DMA_IRQHandler(&hdma_usart3_tx);
   /* USER CODE BEGIN DMA1_Channel2_IRQn 1 */
-
+  IRQ_TRACE_EXIT(IRQ_TRACE_DMA1_CH2);
   /* USER CODE END DMA1_Channel2_IRQn 1 */
 }
 
@@ -228,11 +237,18 @@ void DMA1_Channel2_IRQHandler(void)
 void DMA1_Channel3_IRQHandler(void)
 {
   /* USER CODE BEGIN DMA1_Channel3_IRQn 0 */
-
+  IRQ_TRACE_ENTER(IRQ_TRACE_DMA1_CH3);
+#if BSP_FAST_IRQ_ENABLED
+  if (BSP_FastIRQ_UART_DMA(&hdma_usart3_rx))
+  {
+    IRQ_TRACE_EXIT(IRQ_TRACE_DMA1_CH3);
+    return;
+  }
+#endif
   /* USER CODE END DMA1_Channel3_IRQn 0 */
   HAL_DMA_IRQHandler(&hdma_usart3_rx);
   /* USER CODE BEGIN DMA1_Channel3_IRQn 1 */
-
+  IRQ_TRACE_EXIT(IRQ_TRACE_DMA1_CH3);
   /* USER CODE END DMA1_Channel3_IRQn 1 */
 }
 
@@ -242,11 +258,18 @@ void DMA1_Channel3_IRQHandler(void)
 void DMA1_Channel4_IRQHandler(void)
 {
   /* USER CODE BEGIN DMA1_Channel4_IRQn 0 */
-
+  IRQ_TRACE_ENTER(IRQ_TRACE_DMA1_CH4);
+#if BSP_FAST_IRQ_ENABLED
+  if (BSP_FastIRQ_UART_DMA(&hdma_usart1_tx))
+  {
+    IRQ_TRACE_EXIT(IRQ_TRACE_DMA1_CH4);
+    return;
+  }
+#endif
   /* USER CODE END DMA1_Channel4_IRQn 0 */
   HAL_DMA_IRQHandler(&hdma_usart1_tx);
   /* USER CODE BEGIN DMA1_Channel4_IRQn 1 */
-
+  IRQ_TRACE_EXIT(IRQ_TRACE_DMA1_CH4);
   /* USER CODE END DMA1_Channel4_IRQn 1 */
 }
 
@@ -256,11 +279,18 @@ void DMA1_Channel4_IRQHandler(void)
 void DMA1_Channel5_IRQHandler(void)
 {
   /* USER CODE BEGIN DMA1_Channel5_IRQn 0 */
-
+  IRQ_TRACE_ENTER(IRQ_TRACE_DMA1_CH5);
+#if BSP_FAST_IRQ_ENABLED
+  if (BSP_FastIRQ_UART_DMA(&hdma_usart1_rx))
+  {
+    IRQ_TRACE_EXIT(IRQ_TRACE_DMA1_CH5);
+    return;
+  }
+#endif
   /* USER CODE END DMA1_Channel5_IRQn 0 */
   HAL_DMA_IRQHandler(&hdma_usart1_rx);
   /* USER CODE BEGIN DMA1_Channel5_IRQn 1 */
-
+  IRQ_TRACE_EXIT(IRQ_TRACE_DMA1_CH5);
   /* USER CODE END DMA1_Channel5_IRQn 1 */
 }
 
@@ -270,11 +300,18 @@ void DMA1_Channel5_IRQHandler(void)
 void DMA1_Channel6_IRQHandler(void)
 {
   /* USER CODE BEGIN DMA1_Channel6_IRQn 0 */
-
+  IRQ_TRACE_ENTER(IRQ_TRACE_DMA1_CH6);
+#if BSP_FAST_IRQ_ENABLED
+  if (BSP_FastIRQ_UART_DMA(&hdma_usart2_rx))
+  {
+    IRQ_TRACE_EXIT(IRQ_TRACE_DMA1_CH6);
+    return;
+  }
+#endif
   /* USER CODE END DMA1_Channel6_IRQn 0 */
   HAL_DMA_IRQHandler(&hdma_usart2_rx);
   /* USER CODE BEGIN DMA1_Channel6_IRQn 1 */
-
+  IRQ_TRACE_EXIT(IRQ_TRACE_DMA1_CH6);
   /* USER CODE END DMA1_Channel6_IRQn 1 */
 }
 
@@ -284,11 +321,18 @@ void DMA1_Channel6_IRQHandler(void)
 void DMA1_Channel7_IRQHandler(void)
 {
   /* USER CODE BEGIN DMA1_Channel7_IRQn 0 */
-
+  IRQ_TRACE_ENTER(IRQ_TRACE_DMA1_CH7);
+#if BSP_FAST_IRQ_ENABLED
+  if (BSP_FastIRQ_UART_DMA(&hdma_usart2_tx))
+  {
+    IRQ_TRACE_EXIT(IRQ_TRACE_DMA1_CH7);
+    return;
+  }
+#endif
   /* USER CODE END DMA1_Channel7_IRQn 0 */
   HAL_DMA_IRQHandler(&hdma_usart2_tx);
   /* USER CODE BEGIN DMA1_Channel7_IRQn 1 */
-
+  IRQ_TRACE_EXIT(IRQ_TRACE_DMA1_CH7);
   /* USER CODE END DMA1_Channel7_IRQn 1 */
 }
 
@@ -298,11 +342,11 @@ void DMA1_Channel7_IRQHandler(void)
 void USB_HP_CAN1_TX_IRQHandler(void)
 {
   /* USER CODE BEGIN USB_HP_CAN1_TX_IRQn 0 */
-
+  IRQ_TRACE_ENTER(IRQ_TRACE_CAN1_TX);
   /* USER CODE END USB_HP_CAN1_TX_IRQn 0 */
   HAL_CAN_IRQHandler(&hcan);
   /* USER CODE BEGIN USB_HP_CAN1_TX_IRQn 1 */
-
+  IRQ_TRACE_EXIT(IRQ_TRACE_CAN1_TX);
   /* USER CODE END USB_HP_CAN1_TX_IRQn 1 */
 }
 
@@ -312,11 +356,18 @@ void USB_HP_CAN1_TX_IRQHandler(void)
 void USB_LP_CAN1_RX0_IRQHandler(void)
 {
   /* USER CODE BEGIN USB_LP_CAN1_RX0_IRQn 0 */
-
+  IRQ_TRACE_ENTER(IRQ_TRACE_CAN1_RX0);
+#if BSP_FAST_IRQ_ENABLED
+  if (BSP_FastIRQ_CAN_RX(&hcan, CAN_RX_FIFO0))
+  {
+    IRQ_TRACE_EXIT(IRQ_TRACE_CAN1_RX0);
+    return;
+  }
+#endif
   /* USER CODE END USB_LP_CAN1_RX0_IRQn 0 */
   HAL_CAN_IRQHandler(&hcan);
   /* USER CODE BEGIN USB_LP_CAN1_RX0_IRQn 1 */
-
+  IRQ_TRACE_EXIT(IRQ_TRACE_CAN1_RX0);
   /* USER CODE END USB_LP_CAN1_RX0_IRQn 1 */
 }
 
@@ -326,11 +377,18 @@ void USB_LP_CAN1_RX0_IRQHandler(void)
 void CAN1_RX1_IRQHandler(void)
 {
   /* USER CODE BEGIN CAN1_RX1_IRQn 0 */
-
+  IRQ_TRACE_ENTER(IRQ_TRACE_CAN1_RX1);
+#if BSP_FAST_IRQ_ENABLED
+  if (BSP_FastIRQ_CAN_RX(&hcan, CAN_RX_FIFO1))
+  {
+    IRQ_TRACE_EXIT(IRQ_TRACE_CAN1_RX1);
+    return;
+  }
+#endif
   /* USER CODE END CAN1_RX1_IRQn 0 */
   HAL_CAN_IRQHandler(&hcan);
   /* USER CODE BEGIN CAN1_RX1_IRQn 1 */
-
+  IRQ_TRACE_EXIT(IRQ_TRACE_CAN1_RX1);
   /* USER CODE END CAN1_RX1_IRQn 1 */
 }
 
@@ -340,11 +398,11 @@ void CAN1_RX1_IRQHandler(void)
 void CAN1_SCE_IRQHandler(void)
 {
   /* USER CODE BEGIN CAN1_SCE_IRQn 0 */
-
+  IRQ_TRACE_ENTER(IRQ_TRACE_CAN1_SCE);
   /* USER CODE END CAN1_SCE_IRQn 0 */
   HAL_CAN_IRQHandler(&hcan);
   /* USER CODE BEGIN CAN1_SCE_IRQn 1 */
-
+  IRQ_TRACE_EXIT(IRQ_TRACE_CAN1_SCE);
   /* USER CODE END CAN1_SCE_IRQn 1 */
 }
 
@@ -354,11 +412,18 @@ void CAN1_SCE_IRQHandler(void)
 void EXTI9_5_IRQHandler(void)
 {
   /* USER CODE BEGIN EXTI9_5_IRQn 0 */
-
+  IRQ_TRACE_ENTER(IRQ_TRACE_EXTI9_5);
+#if BSP_FAST_IRQ_ENABLED
+  if (BSP_FastIRQ_EXTI(EXTI_PR_PR5 | EXTI_PR_PR6 | EXTI_PR_PR7 | EXTI_PR_PR8 | EXTI_PR_PR9))
+  {
+    IRQ_TRACE_EXIT(IRQ_TRACE_EXTI9_5);
+    return;
+  }
+#endif
   /* USER CODE END EXTI9_5_IRQn 0 */
   HAL_GPIO_EXTI_IRQHandler(finger_detect_Pin);
   /* USER CODE BEGIN EXTI9_5_IRQn 1 */
-
+  IRQ_TRACE_EXIT(IRQ_TRACE_EXTI9_5);
   /* USER CODE END EXTI9_5_IRQn 1 */
 }
 
@@ -368,11 +433,11 @@ void EXTI9_5_IRQHandler(void)
 void TIM4_IRQHandler(void)
 {
   /* USER CODE BEGIN TIM4_IRQn 0 */
-
+  IRQ_TRACE_ENTER(IRQ_TRACE_TIM4);
   /* USER CODE END TIM4_IRQn 0 */
   HAL_TIM_IRQHandler(&htim4);
   /* USER CODE BEGIN TIM4_IRQn 1 */
-
+  IRQ_TRACE_EXIT(IRQ_TRACE_TIM4);
   /* USER CODE END TIM4_IRQn 1 */
 }
 
@@ -382,11 +447,18 @@ void TIM4_IRQHandler(void)
 void USART1_IRQHandler(void)
 {
   /* USER CODE BEGIN USART1_IRQn 0 */
-
+  IRQ_TRACE_ENTER(IRQ_TRACE_USART1);
+#if BSP_FAST_IRQ_ENABLED
+  if (BSP_FastIRQ_UART(&huart1))
+  {
+    IRQ_TRACE_EXIT(IRQ_TRACE_USART1);
+    return;
+  }
+#endif
   /* USER CODE END USART1_IRQn 0 */
   HAL_UART_IRQHandler(&huart1);
   /* USER CODE BEGIN USART1_IRQn 1 */
-
+  IRQ_TRACE_EXIT(IRQ_TRACE_USART1);
   /* USER CODE END USART1_IRQn 1 */
 }
 
@@ -396,11 +468,18 @@ void USART1_IRQHandler(void)
 void USART2_IRQHandler(void)
 {
   /* USER CODE BEGIN USART2_IRQn 0 */
-
+  IRQ_TRACE_ENTER(IRQ_TRACE_USART2);
+#if BSP_FAST_IRQ_ENABLED
+  if (BSP_FastIRQ_UART(&huart2))
+  {
+    IRQ_TRACE_EXIT(IRQ_TRACE_USART2);
+    return;
+  }
+#endif
   /* USER CODE END USART2_IRQn 0 */
   HAL_UART_IRQHandler(&huart2);
   /* USER CODE BEGIN USART2_IRQn 1 */
-
+  IRQ_TRACE_EXIT(IRQ_TRACE_USART2);
   /* USER CODE END USART2_IRQn 1 */
 }
 
@@ -410,11 +489,18 @@ void USART2_IRQHandler(void)
 void USART3_IRQHandler(void)
 {
   /* USER CODE BEGIN USART3_IRQn 0 */
-
+  IRQ_TRACE_ENTER(IRQ_TRACE_USART3);
+#if BSP_FAST_IRQ_ENABLED
+  if (BSP_FastIRQ_UART(&huart3))
+  {
+    IRQ_TRACE_EXIT(IRQ_TRACE_USART3);
+    return;
+  }
+#endif
   /* USER CODE END USART3_IRQn 0 */
   HAL_UART_IRQHandler(&huart3);
   /* USER CODE BEGIN USART3_IRQn 1 */
-
+  IRQ_TRACE_EXIT(IRQ_TRACE_USART3);
   /* USER CODE END USART3_IRQn 1 */
 }
 
@@ -424,11 +510,18 @@ void USART3_IRQHandler(void)
 void EXTI15_10_IRQHandler(void)
 {
   /* USER CODE BEGIN EXTI15_10_IRQn 0 */
-
+  IRQ_TRACE_ENTER(IRQ_TRACE_EXTI15_10);
+#if BSP_FAST_IRQ_ENABLED
+  if (BSP_FastIRQ_EXTI(EXTI_PR_PR10 | EXTI_PR_PR11 | EXTI_PR_PR12 | EXTI_PR_PR13 | EXTI_PR_PR14 | EXTI_PR_PR15))
+  {
+    IRQ_TRACE_EXIT(IRQ_TRACE_EXTI15_10);
+    return;
+  }
+#endif
   /* USER CODE END EXTI15_10_IRQn 0 */
   HAL_GPIO_EXTI_IRQHandler(human_detect_Pin);
   /* USER CODE BEGIN EXTI15_10_IRQn 1 */
-
+  IRQ_TRACE_EXIT(IRQ_TRACE_EXTI15_10);
   /* USER CODE END EXTI15_10_IRQn 1 */
 }
 
@@ -0,0 +1,217 @@
+/**
+ * @file  dwt_extend_test.cpp
+ * @brief 主机端测试: 用模拟的32位CYCCNT驱动bsp::dwt::extend_cycles,覆盖数周运行中的多次回绕、
+ *        间隔略小于/略大于半周期的读取,以及中断在读取过程中嵌套读取的情形
+ * @note  不依赖HAL,在主机上编译运行:
+ *        g++ -std=c++23 -Wall -Wextra -ISrc test/dwt/dwt_extend_test.cpp -o dwt_extend_test
+ *        && ./dwt_extend_test
+ */
+#include "bsp/dwt/dwt_extend.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <random>
+
+namespace {
+
+constexpr uint64_t HALF_PERIOD = 1ULL << 31;
+constexpr uint64_t CPU_FREQ_HZ = 72000000ULL;
+
+int failures = 0;
+
+void check(bool condition, const char* what, uint64_t expected, uint64_t actual) {
+    if (!condition) {
+        ++failures;
+        std::printf("FAIL %s: expected %llu, got %llu\n", what,
+                    static_cast<unsigned long long>(expected),
+                    static_cast<unsigned long long>(actual));
+    }
+}
+
+// 模拟的CYCCNT: 真实的64位时间只用于校验,读取时截断为32位
+struct fake_counter {
+    uint64_t now = 0;
+    uint32_t read() const { return static_cast<uint32_t>(now); }
+};
+
+/**
+ * 半周期计数的包装,可在load之后或CAS之前插入一次"中断",模拟主循环读取到一半时被打断
+ */
+struct hooked_half_count {
+    std::atomic<uint32_t> value{0};
+    std::function<void()> before_cas;
+
+    uint32_t load(std::memory_order order) const { return value.load(order); }
+    bool compare_exchange_strong(uint32_t& expected, uint32_t desired, std::memory_order order) {
+        if (before_cas) {
+            auto hook  = std::move(before_cas);
+            before_cas = nullptr;
+            hook();
+        }
+        return value.compare_exchange_strong(expected, desired, order);
+    }
+};
+
+uint64_t read_cycles(hooked_half_count& half, fake_counter& counter,
+                     std::function<void()> before_read = nullptr,
+                     std::function<void()> after_read  = nullptr) {
+    return bsp::dwt::extend_cycles(half, [&] {
+        if (before_read) {
+            before_read();
+        }
+        uint32_t cnt = counter.read();
+        if (after_read) {
+            after_read();
+        }
+        return cnt;
+    });
+}
+
+// 42天随机间隔(均不超过半周期)的读取,每次结果须与真实时间完全一致
+void test_weeks_of_uptime() {
+    hooked_half_count half;
+    fake_counter counter;
+    std::mt19937_64 rng(20221008);
+    std::uniform_int_distribution<uint64_t> step(1, HALF_PERIOD - 1);
+
+    const uint64_t end = 42ULL * 24 * 3600 * CPU_FREQ_HZ;
+    uint64_t reads     = 0;
+    while (counter.now < end) {
+        counter.now += step(rng);
+        uint64_t got = read_cycles(half, counter);
+        check(got == counter.now, "weeks of uptime", counter.now, got);
+        ++reads;
+    }
+    std::printf("weeks of uptime: %llu reads, %llu wraps\n", static_cast<unsigned long long>(reads),
+                static_cast<unsigned long long>(counter.now >> 32));
+}
+
+// 间隔恰好略小于半周期,从每种相位出发都必须精确
+void test_spacing_just_under_half_period() {
+    const uint64_t phases[] = {0, 1, HALF_PERIOD - 1, HALF_PERIOD, (1ULL << 32) - 1};
+    for (uint64_t phase : phases) {
+        hooked_half_count half;
+        fake_counter counter;
+        counter.now = phase;
+        // 起点之前的时间按约定已由更早的读取维持
+        half.value  = static_cast<uint32_t>(phase >> 31);
+        for (int i = 0; i < 64; ++i) {
+            counter.now += HALF_PERIOD - 1;
+            uint64_t got = read_cycles(half, counter);
+            check(got == counter.now, "spacing just under half period", counter.now, got);
+        }
+    }
+}
+
+// 间隔略大于半周期违反约定: 从半周期前一刻出发,下一次读取恰好落在回绕后,会漏掉一次回绕
+void test_spacing_just_over_half_period() {
+    hooked_half_count half;
+    fake_counter counter;
+    counter.now = HALF_PERIOD - 1;
+    check(read_cycles(half, counter) == counter.now, "over: first read", counter.now, 0);
+
+    counter.now += HALF_PERIOD + 1; // 恰为2^32
+    uint64_t got = read_cycles(half, counter);
+    check(got == counter.now - (1ULL << 32), "spacing just over half period loses one wrap",
+          counter.now - (1ULL << 32), got);
+}
+
+// 中断在主循环读取半周期计数之后、读取CYCCNT之前嵌套读取,且期间CYCCNT越过半周期边界
+void test_nested_before_counter_read() {
+    const uint64_t boundaries[] = {HALF_PERIOD, 1ULL << 32, 3 * HALF_PERIOD, 5ULL << 32};
+    for (uint64_t boundary : boundaries) {
+        hooked_half_count half;
+        fake_counter counter;
+        counter.now = boundary - 100;
+        half.value  = static_cast<uint32_t>(counter.now >> 31);
+        check(read_cycles(half, counter) == counter.now, "read before boundary", counter.now, 0);
+
+        counter.now   = boundary - 10;
+        uint64_t isr  = 0;
+        uint64_t main = read_cycles(half, counter, [&] {
+            counter.now += 20; // 进入中断时已越过边界
+            isr = read_cycles(half, counter);
+            counter.now += 5;  // 返回主循环后继续计数
+        });
+        check(isr == boundary + 10, "nested reader before counter read (isr)", boundary + 10, isr);
+        check(main == boundary + 15, "nested reader before counter read (main)", boundary + 15,
+              main);
+
+        counter.now += 1000;
+        uint64_t after = read_cycles(half, counter);
+        check(after == counter.now, "read after nested reader", counter.now, after);
+    }
+}
+
+// 中断在主循环读取CYCCNT之后嵌套读取并发布新的半周期计数,主循环仍须按旧的计数拼出结果
+void test_nested_after_counter_read() {
+    const uint64_t boundaries[] = {HALF_PERIOD, 1ULL << 32, 3 * HALF_PERIOD};
+    for (uint64_t boundary : boundaries) {
+        hooked_half_count half;
+        fake_counter counter;
+        counter.now = boundary - 100;
+        half.value  = static_cast<uint32_t>(counter.now >> 31);
+        check(read_cycles(half, counter) == counter.now, "read before boundary", counter.now, 0);
+
+        counter.now   = boundary - 10;
+        uint64_t isr  = 0;
+        uint64_t main = read_cycles(half, counter, nullptr, [&] {
+            counter.now += 20;
+            isr = read_cycles(half, counter);
+        });
+        check(main == boundary - 10, "nested reader after counter read (main)", boundary - 10,
+              main);
+        check(isr == boundary + 10, "nested reader after counter read (isr)", boundary + 10, isr);
+
+        counter.now += 1000;
+        uint64_t after = read_cycles(half, counter);
+        check(after == counter.now, "read after nested reader", counter.now, after);
+    }
+}
+
+// 中断在主循环已读CYCCNT、准备CAS发布时嵌套读取并抢先发布
+void test_nested_before_cas() {
+    const uint64_t boundaries[] = {HALF_PERIOD, 1ULL << 32, 7 * HALF_PERIOD};
+    for (uint64_t boundary : boundaries) {
+        hooked_half_count half;
+        fake_counter counter;
+        counter.now = boundary - 100;
+        half.value  = static_cast<uint32_t>(counter.now >> 31);
+        check(read_cycles(half, counter) == counter.now, "read before boundary", counter.now, 0);
+
+        counter.now     = boundary + 10;
+        uint64_t isr    = 0;
+        half.before_cas = [&] {
+            counter.now += 30;
+            isr = read_cycles(half, counter);
+        };
+        uint64_t main = read_cycles(half, counter);
+        check(main == boundary + 10, "nested reader before CAS (main)", boundary + 10, main);
+        check(isr == boundary + 40, "nested reader before CAS (isr)", boundary + 40, isr);
+        check(half.value.load() == static_cast<uint32_t>((boundary + 40) >> 31),
+              "half count published once", (boundary + 40) >> 31, half.value.load());
+
+        counter.now += HALF_PERIOD - 1;
+        uint64_t after = read_cycles(half, counter);
+        check(after == counter.now, "read after CAS race", counter.now, after);
+    }
+}
+
+} // namespace
+
+int main() {
+    test_weeks_of_uptime();
+    test_spacing_just_under_half_period();
+    test_spacing_just_over_half_period();
+    test_nested_before_counter_read();
+    test_nested_after_counter_read();
+    test_nested_before_cas();
+    if (failures != 0) {
+        std::printf("%d failure(s)\n", failures);
+        return 1;
+    }
+    std::printf("all passed\n");
+    return 0;
+}
@@ -19,7 +19,7 @@ target("application", function()
     elseif is_mode("release") then -- 发布模式，开启O3优化和NDEBUG标志
         set_optimize("fastest")-- none-O0, fastest-O3
         -- set_optimize("none")
-        -- add_cxflags("-DNDEBUG")
+        add_cxflags("-DNDEBUG")
     end
 
     -- 从CubeMX生成的Makefile中读取hal的源文件和头文件